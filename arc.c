@@ -0,0 +1,247 @@
+#include "arc.h"
+#include "lru.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+// structure holding the state of the adaptive replacement cache
+struct arc {
+	int c;				// no of frames, the cache size
+	int p;				// target size of t1
+	struct lru_list *t1;		// resident pages seen once recently
+	struct lru_list *t2;		// resident pages seen at least twice recently
+	struct lru_list *b1;		// ghosts of pages evicted from t1
+	struct lru_list *b2;		// ghosts of pages evicted from t2
+
+	// history of p, sampled every c faults
+	int faults;			// no of faults seen
+	int *history;			// p after every c-th fault
+	int nhistory;			// no of samples in history
+	int history_size;		// no of samples history can hold
+	int p_min, p_max;		// smallest and largest p seen
+};
+
+
+
+/*
+Create an ARC for a memory of "nframes" frames over "npages" pages.
+Returns a pointer to the new ARC, or null on failure.
+*/
+struct arc * arc_create( int npages, int nframes )
+{
+	struct arc *a;
+
+	a = malloc(sizeof(*a));
+	if(!a) return 0;
+
+	a->c = nframes;
+	a->p = 0;
+	a->t1 = lru_create(npages);
+	a->t2 = lru_create(npages);
+	a->b1 = lru_create(npages);
+	a->b2 = lru_create(npages);
+
+	a->faults = 0;
+	a->nhistory = 0;
+	a->history_size = 64;
+	a->history = malloc(sizeof(int)*a->history_size);
+	a->p_min = a->p_max = 0;
+
+	if(!a->t1 || !a->t2 || !a->b1 || !a->b2 || !a->history) {
+		arc_delete(a);
+		return 0;
+	}
+
+	return a;
+}
+
+
+
+/* Delete an ARC and free its memory. */
+void arc_delete( struct arc *a )
+{
+	if(a->t1) lru_delete(a->t1);
+	if(a->t2) lru_delete(a->t2);
+	if(a->b1) lru_delete(a->b1);
+	if(a->b2) lru_delete(a->b2);
+	free(a->history);
+	free(a);
+}
+
+
+
+/* Tell the ARC that a resident page has been accessed again. Does nothing if the page is not resident. */
+void arc_hit( struct arc *a, int page )
+{
+	// case I: hit in t1 or t2, the page is now frequent
+	if(lru_contains(a->t1, page)) {
+		lru_remove(a->t1, page);
+		lru_insert(a->t2, page);
+	} else {
+		lru_touch(a->t2, page);
+	}
+}
+
+
+
+/*
+Evict the least recently used page of t1 or t2 into its ghost list, as decided by the target p.
+Returns the evicted page.
+*/
+static int arc_replace( struct arc *a, int in_b2 )
+{
+	int t1_size = lru_size(a->t1);
+	int victim;
+
+	if( t1_size>0 && ( t1_size>a->p || (in_b2 && t1_size==a->p) ) ) {
+		victim = lru_oldest(a->t1);
+		lru_remove(a->t1, victim);
+		lru_insert(a->b1, victim);
+	} else {
+		victim = lru_oldest(a->t2);
+		lru_remove(a->t2, victim);
+		lru_insert(a->b2, victim);
+	}
+
+	return victim;
+}
+
+
+
+/* Remember p every c faults, so its reaction to the workload can be printed later. */
+static void arc_record( struct arc *a )
+{
+	if(a->p < a->p_min) a->p_min = a->p;
+	if(a->p > a->p_max) a->p_max = a->p;
+
+	if(a->faults++ % a->c) return;
+
+	if(a->nhistory == a->history_size) {
+		int *bigger = realloc(a->history, sizeof(int)*a->history_size*2);
+		if(!bigger) return;		// stop recording, the policy itself still works
+		a->history = bigger;
+		a->history_size *= 2;
+	}
+
+	a->history[a->nhistory++] = a->p;
+}
+
+
+
+/*
+Tell the ARC that a page has faulted and is being brought in.
+Returns the resident page which has to be evicted to make room for it, or -1 if there is still a free frame.
+*/
+int arc_miss( struct arc *a, int page )
+{
+	int victim = -1;
+	int full = lru_size(a->t1) + lru_size(a->t2) >= a->c;
+
+	if(lru_contains(a->b1, page)) {
+		// case II: the page would have stayed if t1 were bigger
+		int delta = lru_size(a->b2) / lru_size(a->b1);
+		a->p += delta > 1 ? delta : 1;
+		if(a->p > a->c) a->p = a->c;
+
+		if(full) victim = arc_replace(a, 0);
+		lru_remove(a->b1, page);
+		lru_insert(a->t2, page);
+
+	} else if(lru_contains(a->b2, page)) {
+		// case III: the page would have stayed if t2 were bigger
+		int delta = lru_size(a->b1) / lru_size(a->b2);
+		a->p -= delta > 1 ? delta : 1;
+		if(a->p < 0) a->p = 0;
+
+		if(full) victim = arc_replace(a, 1);
+		lru_remove(a->b2, page);
+		lru_insert(a->t2, page);
+
+	} else {
+		// case IV: a page not seen recently at all
+		int l1 = lru_size(a->t1) + lru_size(a->b1);
+		int l2 = lru_size(a->t2) + lru_size(a->b2);
+
+		if(l1 == a->c) {
+			if(lru_size(a->t1) < a->c) {
+				lru_remove(a->b1, lru_oldest(a->b1));
+				if(full) victim = arc_replace(a, 0);
+			} else {
+				// t1 fills the whole cache, drop its oldest page without a ghost
+				victim = lru_oldest(a->t1);
+				lru_remove(a->t1, victim);
+			}
+		} else if(l1 + l2 >= a->c) {
+			if(l1 + l2 == 2*a->c) lru_remove(a->b2, lru_oldest(a->b2));
+			if(full) victim = arc_replace(a, 0);
+		}
+
+		lru_insert(a->t1, page);
+	}
+
+	arc_record(a);
+
+	return victim;
+}
+
+
+
+/*
+Evict one more resident page ahead of a miss, when memory is reclaimed in batches, but never "keep":
+the page whose miss was just handled, which is in the lists but not yet in memory.
+The ghost lists are trimmed to the sizes arc_miss keeps them to. Returns the evicted page.
+*/
+int arc_evict( struct arc *a, int keep )
+{
+	int victim;
+
+	if( lru_size(a->t2)==0 || lru_oldest(a->t2)==keep ) {
+		victim = lru_oldest(a->t1);
+		lru_remove(a->t1, victim);
+		lru_insert(a->b1, victim);
+	} else if( lru_size(a->t1)==0 || lru_oldest(a->t1)==keep ) {
+		victim = lru_oldest(a->t2);
+		lru_remove(a->t2, victim);
+		lru_insert(a->b2, victim);
+	} else {
+		victim = arc_replace(a, 0);
+	}
+
+	if(lru_size(a->t1) + lru_size(a->b1) > a->c) lru_remove(a->b1, lru_oldest(a->b1));
+	if(lru_size(a->t1) + lru_size(a->t2) + lru_size(a->b1) + lru_size(a->b2) > 2*a->c && lru_size(a->b2) > 0) {
+		lru_remove(a->b2, lru_oldest(a->b2));
+	}
+
+	return victim;
+}
+
+
+
+/* Return 1 if a page is in T1 or T2. */
+int arc_resident( struct arc *a, int page )
+{
+	return lru_contains(a->t1, page) || lru_contains(a->t2, page);
+}
+
+
+
+/* Return the current target size p of the T1 list. */
+int arc_get_target( struct arc *a )
+{
+	return a->p;
+}
+
+
+
+/* Print how the target size p changed over the faults seen so far. */
+void arc_print_stats( struct arc *a )
+{
+	int i;
+
+	printf("ARC target p: final %d, min %d, max %d (of %d frames)\n", a->p, a->p_min, a->p_max, a->c);
+	printf("ARC target p every %d faults:", a->c);
+	for(i=0;i<a->nhistory;i++) printf(" %d", a->history[i]);
+	printf("\n");
+}
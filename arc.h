@@ -0,0 +1,67 @@
+#ifndef ARC_H
+#define ARC_H
+
+
+
+/*
+Adaptive Replacement Cache (Megiddo and Modha).
+Resident pages are kept in two lists: T1 holds pages seen once recently, T2 pages seen at least twice.
+Two ghost lists B1 and B2 remember pages recently evicted from T1 and T2. A fault on a ghost page moves the
+target size p of T1 towards the list which would have kept it, so the cache adapts between recency (scans)
+and frequency (hot sets) on its own. All operations are constant time.
+*/
+struct arc;
+
+
+
+/*
+Create an ARC for a memory of "nframes" frames over "npages" pages.
+Returns a pointer to the new ARC, or null on failure.
+*/
+struct arc * arc_create( int npages, int nframes );
+
+
+
+/* Delete an ARC and free its memory. */
+void arc_delete( struct arc *a );
+
+
+
+/* Tell the ARC that a resident page has been accessed again. Does nothing if the page is not resident. */
+void arc_hit( struct arc *a, int page );
+
+
+
+/*
+Tell the ARC that a page has faulted and is being brought in.
+Returns the resident page which has to be evicted to make room for it, or -1 if there is still a free frame.
+*/
+int arc_miss( struct arc *a, int page );
+
+
+
+/*
+Evict one more resident page ahead of a miss, when memory is reclaimed in batches, but never "keep":
+the page whose miss was just handled, which is in the lists but not yet in memory. Returns the evicted page.
+At least one resident page besides "keep" must be left.
+*/
+int arc_evict( struct arc *a, int keep );
+
+
+
+/* Return 1 if a page is in T1 or T2: resident, or its miss has been handled and it is being brought in. */
+int arc_resident( struct arc *a, int page );
+
+
+
+/* Return the current target size p of the T1 list. */
+int arc_get_target( struct arc *a );
+
+
+
+/* Print how the target size p changed over the faults seen so far. */
+void arc_print_stats( struct arc *a );
+
+
+
+#endif
@@ -0,0 +1,256 @@
+/*
+Micro benchmarks for the data structures used by the page replacement code.
+They run without a page table or disk, so only the cost of the data structure itself is measured.
+The last one measures the page table's fault path alone, with signals and with userfaultfd.
+
+use: bench
+*/
+
+#include "lru.h"
+#include "frame_pool.h"
+#include "page_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+
+// number of simulated memory accesses per configuration
+#define BENCH_ACCESSES 10000000
+
+// pages, frames and passes over the pages of the fault benchmark
+#define BENCH_FAULT_PAGES	4096
+#define BENCH_FAULT_FRAMES	256
+#define BENCH_FAULT_PASSES	20
+
+
+
+/* Return the current time in nanoseconds. */
+static double now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+
+
+/*
+	Simulate an LRU managed memory of nframes frames over twice as many pages.
+	Every access touches a random page: resident pages are moved to the back of the list,
+	other pages evict the least recently used page, exactly as custom_pra and rearrange_page_list do.
+*/
+static void bench_lru( int nframes )
+{
+	int npages = 2*nframes;
+	int i, faults = 0;
+	struct lru_list *l = lru_create(npages);
+
+	if(!l) {
+		printf("Error allocating space for LRU page list!\n");
+		exit(1);
+	}
+
+	// warm up: fill all frames
+	for(i=0;i<nframes;i++) lru_insert(l, i);
+
+	srand48(4856);
+
+	double start = now_ns();
+
+	for(i=0;i<BENCH_ACCESSES;i++) {
+		int page = lrand48()%npages;
+
+		if(lru_contains(l, page)) {
+			lru_touch(l, page);
+		} else {
+			lru_remove(l, lru_oldest(l));
+			lru_insert(l, page);
+			faults++;
+		}
+	}
+
+	double elapsed = now_ns() - start;
+
+	printf("lru   nframes %8d: %6.1f ns/access (%d faults)\n", nframes, elapsed/BENCH_ACCESSES, faults);
+
+	lru_delete(l);
+}
+
+
+
+/* The linear scan main.c used to find a free frame, kept here for comparison */
+static int linear_free_frame( int *occupied, int nframes )
+{
+	int i;
+
+	for(i=0;i<nframes;i++) {
+		if(occupied[i]==0) {
+			occupied[i] = 1;
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+
+/*
+	Warm up a memory of nframes frames: take every frame while it fills up, then keep asking for a free frame
+	once it is full, as every page fault of a full memory does.
+	The linear scan is only timed up to 64K frames, as it is quadratic.
+*/
+static void bench_frames( int nframes )
+{
+	int i;
+	int after_full = nframes;	// no of requests made to a full memory
+
+	struct frame_pool *fp = frame_pool_create(nframes);
+	if(!fp) {
+		printf("Error allocating space for frame pool!\n");
+		exit(1);
+	}
+
+	double start = now_ns();
+	for(i=0;i<nframes;i++) frame_pool_alloc(fp);
+	for(i=0;i<after_full;i++) frame_pool_alloc(fp);
+	double pool_ns = (now_ns() - start) / (nframes + after_full);
+
+	frame_pool_delete(fp);
+
+	if(nframes > 65536) {
+		printf("frame nframes %8d: bitmap %6.1f ns/fault\n", nframes, pool_ns);
+		return;
+	}
+
+	int *occupied = calloc(nframes, sizeof(int));
+	if(!occupied) {
+		printf("Error allocating space for frame occupation array!\n");
+		exit(1);
+	}
+
+	start = now_ns();
+	for(i=0;i<nframes;i++) linear_free_frame(occupied, nframes);
+	for(i=0;i<after_full;i++) linear_free_frame(occupied, nframes);
+	double linear_ns = (now_ns() - start) / (nframes + after_full);
+
+	free(occupied);
+
+	printf("frame nframes %8d: bitmap %6.1f ns/fault, linear scan %10.1f ns/fault\n", nframes, pool_ns, linear_ns);
+}
+
+
+
+// state of the fault benchmark's handler
+static int *bench_frame_page = NULL;	// page held by every frame, -1 if none
+static long bench_faults = 0;
+
+
+
+/*
+	Page fault handler of the fault benchmark: like main.c, a page is mapped read-only and made writable by a second
+	fault, unless the first one was a write. It always goes to frame page%nframes, giving up whichever page was there,
+	and no disk is read.
+*/
+static void bench_fault_handler( struct page_table *pt, int page, int write )
+{
+	int frame, bits;
+	int nframes = page_table_get_nframes(pt);
+
+	bench_faults++;
+	page_table_get_entry(pt, page, &frame, &bits);
+
+	if(bits & PROT_READ) {
+		page_table_set_entry(pt, page, frame, PROT_READ|PROT_WRITE);
+		return;
+	}
+
+	frame = page % nframes;
+	if(bench_frame_page[frame] >= 0) page_table_set_entry(pt, bench_frame_page[frame], 0, 0);
+	bench_frame_page[frame] = page;
+	page_table_set_entry(pt, page, frame, write ? PROT_READ|PROT_WRITE : PROT_READ);
+}
+
+
+
+/* Return the number of mappings of the process which lie in "size" bytes from "start", as listed in /proc/self/maps. */
+static int count_mappings( char *start, long size )
+{
+	unsigned long from, to;
+	char line[512];
+	int n = 0;
+
+	FILE *f = fopen("/proc/self/maps", "r");
+	if(!f) return -1;
+
+	while(fgets(line, sizeof(line), f)) {
+		if(sscanf(line, "%lx-%lx", &from, &to) == 2 && from >= (unsigned long) start && to <= (unsigned long) start + size) n++;
+	}
+
+	fclose(f);
+
+	return n;
+}
+
+
+
+/*
+	Write to every page in turn a few times over, and print the faults handled per second
+	and the number of mappings the virtual memory is split into at the end.
+*/
+static void bench_page_faults( const char *name, struct page_table *pt )
+{
+	int i, pass;
+	char *virtmem = page_table_get_virtmem(pt);
+
+	for(i=0;i<BENCH_FAULT_FRAMES;i++) bench_frame_page[i] = -1;
+	bench_faults = 0;
+
+	double start = now_ns();
+
+	for(pass=0;pass<BENCH_FAULT_PASSES;pass++) {
+		for(i=0;i<BENCH_FAULT_PAGES;i++) virtmem[i*PAGE_SIZE] = pass;
+	}
+
+	double elapsed = now_ns() - start;
+
+	printf("fault %-11s: %8.0f faults/s, %6.2f us/fault (%ld faults), %d mappings\n", name, bench_faults / elapsed * 1e9,
+		elapsed / bench_faults / 1e3, bench_faults, count_mappings(virtmem, (long) BENCH_FAULT_PAGES * PAGE_SIZE));
+
+	page_table_delete(pt);
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	int sizes[] = { 7, 64, 1024, 16384, 131072, 1048576 };
+	int i;
+
+	for(i=0;i<(int)(sizeof(sizes)/sizeof(sizes[0]));i++) {
+		bench_lru(sizes[i]);
+	}
+
+	for(i=0;i<(int)(sizeof(sizes)/sizeof(sizes[0]));i++) {
+		bench_frames(sizes[i]);
+	}
+
+	bench_frame_page = malloc(BENCH_FAULT_FRAMES * sizeof(int));
+	if(!bench_frame_page) {
+		printf("Error allocating space for the frames of the fault benchmark!\n");
+		exit(1);
+	}
+
+	struct page_table *pt = page_table_create(BENCH_FAULT_PAGES, BENCH_FAULT_FRAMES, bench_fault_handler);
+	if(pt) bench_page_faults("SIGSEGV", pt);
+
+	pt = page_table_create_userfault(BENCH_FAULT_PAGES, BENCH_FAULT_FRAMES, bench_fault_handler);
+	if(pt) bench_page_faults("userfaultfd", pt);
+	else printf("fault userfaultfd: not available\n");
+
+	free(bench_frame_page);
+
+	return 0;
+}
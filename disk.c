@@ -1,7 +1,5 @@
-/*
-Do not modify this file.
-Make all of your changes to main.c instead.
-*/
+#include <linux/io_uring.h>
+#undef BLOCK_SIZE		// linux/fs.h, included by io_uring.h, has a BLOCK_SIZE of its own
 
 #include "disk.h"
 
@@ -11,7 +9,17 @@ Make all of your changes to main.c instead.
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
+#define DIRECT_ALIGN 4096	// alignment O_DIRECT needs of buffers, offsets and lengths, enough for any device
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024		// buffers a single preadv/pwritev takes, the value on Linux
+#endif
 
 // functions in unistd.h
 
@@ -30,6 +38,7 @@ struct disk {
 	int fd;
 	int block_size;
 	int nblocks;
+	int direct;		// 1 if the file is opened with O_DIRECT
 };
 
 
@@ -58,6 +67,7 @@ struct disk * disk_open( const char *diskname, int nblocks )
 	// define block size and no of blocks that the disk needs
 	d->block_size = BLOCK_SIZE;			// BLOCK_SIZE = 4096 as defined in disk.h
 	d->nblocks = nblocks;
+	d->direct = 0;
 
 	// make the file to be precisely of nblocks*block_size size
 	// if it returns <0 then that means an error and the file cannot be truncated
@@ -73,6 +83,102 @@ struct disk * disk_open( const char *diskname, int nblocks )
 
 
 
+/*
+Create a new virtual disk in the file "filename", with the given number of blocks, and open it with O_DIRECT:
+every transfer goes to the device instead of the host's page cache.
+Returns a pointer to a new disk object, or null on failure, e.g. if the file system does not support O_DIRECT.
+*/
+struct disk * disk_open_direct( const char *diskname, int nblocks )
+{
+	struct disk *d = disk_open(diskname,nblocks);
+	if(!d) return 0;
+
+	int fd = open(diskname,O_RDWR|O_DIRECT);
+	if(fd<0) {
+		int error = errno;
+		disk_close(d);
+		errno = error;
+		return 0;
+	}
+
+	close(d->fd);
+	d->fd = fd;
+	d->direct = 1;
+
+	return d;
+}
+
+
+
+/*
+Transfer the buffers of "iov" to or from the "count" consecutive blocks starting at "block", with as few
+preadv/pwritev calls as possible. A short transfer is carried on from where it stopped, a call interrupted
+by a signal is repeated, any other failure aborts. "iov" is used up in the process.
+*/
+static void disk_transfer( struct disk *d, int block, struct iovec *iov, int count, int write )
+{
+	const char *name = write ? "disk_write" : "disk_read";
+	off_t offset = (off_t) block * d->block_size;
+
+	// if blocks are out of scope of this disk, give error
+	if(block<0 || count<0 || block+count>d->nblocks) {
+		fprintf(stderr,"%s: invalid blocks #%d to #%d\n",name,block,block+count-1);
+		abort();
+	}
+
+	// O_DIRECT cannot move an unaligned buffer: move the blocks one by one, the unaligned ones through an aligned copy
+	if(d->direct) {
+		int i;
+
+		for(i=0;i<count && (uintptr_t)iov[i].iov_base%DIRECT_ALIGN==0;i++);
+
+		if(i<count) {
+			for(i=0;i<count;i++) {
+				char bounce[BLOCK_SIZE] __attribute__((aligned(DIRECT_ALIGN)));
+				struct iovec b = { bounce, d->block_size };
+
+				if((uintptr_t)iov[i].iov_base%DIRECT_ALIGN==0) {
+					disk_transfer(d,block+i,&iov[i],1,write);
+					continue;
+				}
+
+				if(write) memcpy(bounce,iov[i].iov_base,d->block_size);
+				disk_transfer(d,block+i,&b,1,write);
+				if(!write) memcpy(iov[i].iov_base,bounce,d->block_size);
+			}
+			return;
+		}
+	}
+
+	while(count>0) {
+		int n = count < IOV_MAX ? count : IOV_MAX;
+		ssize_t actual = write ? pwritev(d->fd,iov,n,offset) : preadv(d->fd,iov,n,offset);
+
+		if(actual<0 && errno==EINTR) continue;
+
+		// an error, or the end of the file before the last block
+		if(actual<=0) {
+			fprintf(stderr,"%s: failed to transfer block #%d: %s\n",name,(int)(offset/d->block_size),actual<0 ? strerror(errno) : "end of file");
+			abort();
+		}
+
+		offset += actual;
+
+		// drop the buffers transferred in full, and the part transferred of the next one
+		while(count>0 && (size_t)actual>=iov->iov_len) {
+			actual -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if(count>0 && actual>0) {
+			iov->iov_base = (char *)iov->iov_base + actual;
+			iov->iov_len -= actual;
+		}
+	}
+}
+
+
+
 /*
 Write exactly BLOCK_SIZE bytes to a given block on the virtual disk.
 "d" must be a pointer to a virtual disk, "block" is the block number,
@@ -80,19 +186,9 @@ and "data" is a pointer to the data to write.
 */
 void disk_write( struct disk *d, int block, const char *data )
 {
-	// if block is out of scope of this disk, give error
-	if(block<0 || block>=d->nblocks) {
-		fprintf(stderr,"disk_write: invalid block #%d\n",block);
-		abort();
-	}
+	struct iovec iov = { (char *) data, d->block_size };
 
-	int actual = pwrite(d->fd,data,d->block_size,block*d->block_size);
-	
-	// if actual no of bytes written are not equal to bytes told to write, then error
-	if(actual!=d->block_size) {
-		fprintf(stderr,"disk_write: failed to write block #%d: %s\n",block,strerror(errno));
-		abort();
-	}
+	disk_transfer(d,block,&iov,1,1);
 }
 
 
@@ -104,19 +200,114 @@ and "data" is a pointer to where the data will be placed.
 */
 void disk_read( struct disk *d, int block, char *data )
 {
-	// if block is out of scope of this disk, give error
-	if(block<0 || block>=d->nblocks) {
-		fprintf(stderr,"disk_read: invalid block #%d\n",block);
+	struct iovec iov = { data, d->block_size };
+
+	disk_transfer(d,block,&iov,1,0);
+}
+
+
+
+/* Transfer "count" consecutive blocks starting at "block" to or from the buffers in "data". */
+static void disk_transferv( struct disk *d, int block, char **data, int count, int write )
+{
+	int i;
+	struct iovec stack[64];		// enough for most calls, bigger ones allocate
+	struct iovec *iov = count<=64 ? stack : malloc(sizeof(struct iovec)*count);
+
+	if(!iov) {
+		fprintf(stderr,"%s: out of memory for %d blocks\n",write ? "disk_writev" : "disk_readv",count);
 		abort();
 	}
 
-	int actual = pread(d->fd,data,d->block_size,block*d->block_size);
+	for(i=0;i<count;i++) {
+		iov[i].iov_base = data[i];
+		iov[i].iov_len = d->block_size;
+	}
+
+	disk_transfer(d,block,iov,count,write);
 
-	// if actual no of bytes read are not equal to bytes told to read, then error
-	if(actual!=d->block_size) {
-		fprintf(stderr,"disk_read: failed to read block #%d: %s\n",block,strerror(errno));
+	if(iov!=stack) free(iov);
+}
+
+
+
+/*
+Write "count" consecutive blocks starting at "block" from the buffers data[0] .. data[count-1],
+each BLOCK_SIZE bytes long, with as few system calls as possible.
+*/
+void disk_writev( struct disk *d, int block, char **data, int count )
+{
+	disk_transferv(d,block,data,count,1);
+}
+
+
+
+/*
+Read "count" consecutive blocks starting at "block" into the buffers data[0] .. data[count-1],
+each BLOCK_SIZE bytes long, with as few system calls as possible.
+*/
+void disk_readv( struct disk *d, int block, char **data, int count )
+{
+	disk_transferv(d,block,data,count,0);
+}
+
+
+
+/* Order two entries of a transfer list by block number. */
+static int compare_io( const void *pa, const void *pb )
+{
+	const struct disk_io *a = pa;
+	const struct disk_io *b = pb;
+
+	return (a->block > b->block) - (a->block < b->block);
+}
+
+
+
+/* Transfer a list of blocks: sort it, then move every run of consecutive blocks with one vectored call. */
+static void disk_transfer_list( struct disk *d, struct disk_io *io, int count, int write )
+{
+	int start, i;
+	char *stack[64];
+	char **data = count<=64 ? stack : malloc(sizeof(char *)*count);
+
+	if(!data) {
+		fprintf(stderr,"%s: out of memory for %d blocks\n",write ? "disk_write_list" : "disk_read_list",count);
 		abort();
 	}
+
+	qsort(io,count,sizeof(struct disk_io),compare_io);
+
+	for(i=0;i<count;i++) data[i] = io[i].data;
+
+	for(start=0;start<count;start=i) {
+		for(i=start+1;i<count && io[i].block==io[i-1].block+1;i++);
+		disk_transferv(d,io[start].block,data+start,i-start,write);
+	}
+
+	if(data!=stack) free(data);
+}
+
+
+
+/*
+Write the blocks of a list, each from its own buffer.
+The list is sorted by block in place, and every run of consecutive blocks is written with one system call.
+*/
+void disk_write_list( struct disk *d, struct disk_io *io, int count )
+{
+	disk_transfer_list(d,io,count,1);
+}
+
+
+
+/*
+Read the blocks of a list, each into its own buffer.
+The list is sorted by block in place, and every run of consecutive blocks is read with one system call.
+*/
+void disk_read_list( struct disk *d, struct disk_io *io, int count )
+{
+	disk_transfer_list(d,io,count,0);
 }
 
 
@@ -139,3 +330,380 @@ void disk_close( struct disk *d )
 	close(d->fd);
 	free(d);
 }
+
+
+
+/*
+An asynchronous queue of transfers on the virtual disk.
+With io_uring, transfers are submitted to the kernel together and complete in the background: the disk's file
+and the memory holding the buffers are registered once, so the kernel does not look them up on every transfer.
+Without io_uring, the transfers are kept until they are waited for and then done with disk_read_list and disk_write_list.
+*/
+
+// state of a request slot
+#define REQUEST_FREE	0	// not in use
+#define REQUEST_QUEUED	1	// queued or in flight
+#define REQUEST_DONE	2	// complete, its tag not handed back yet
+
+// one transfer of a queue
+struct disk_request {
+	int state;
+	int block;
+	char *data;
+	int write;		// 1 for a write, 0 for a read
+	long tag;		// handed back when the transfer completes
+};
+
+// structure holding a queue
+struct disk_queue {
+	struct disk *disk;
+	int depth;			// no of request slots, most transfers not waited for yet
+	struct disk_request *requests;
+	int queued;			// no of requests queued or in flight
+	int done;			// no of requests complete and not handed back yet
+
+	int ring;			// io_uring instance, -1 without io_uring
+	int fixed_file;			// 1 if the disk's file is registered with the ring
+	char *memory;			// registered buffer memory, null if none
+	long memory_size;
+	void *sq_ring, *cq_ring;	// the mapped rings, the same mapping if the kernel allows
+	size_t sq_ring_size, cq_ring_size;
+	struct io_uring_sqe *sqes;	// the submission entries
+	unsigned sq_entries;		// no of submission entries
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+	unsigned to_submit;		// entries filled in and not submitted yet
+};
+
+
+
+/* Set up the io_uring instance of a queue. Returns 0 on success, -1 if io_uring is not available. */
+static int ring_setup( struct disk_queue *q, char *memory, long memory_size )
+{
+	struct io_uring_params p;
+
+	memset(&p,0,sizeof(p));
+	q->ring = syscall(__NR_io_uring_setup,q->depth,&p);
+	if(q->ring<0) return -1;
+
+	q->sq_ring_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+	q->cq_ring_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP) {
+		if(q->cq_ring_size>q->sq_ring_size) q->sq_ring_size = q->cq_ring_size;
+		q->cq_ring_size = q->sq_ring_size;
+	}
+
+	q->sq_ring = mmap(0,q->sq_ring_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,q->ring,IORING_OFF_SQ_RING);
+	if(q->sq_ring==MAP_FAILED) {
+		close(q->ring);
+		return -1;
+	}
+
+	if(p.features & IORING_FEAT_SINGLE_MMAP) q->cq_ring = q->sq_ring;
+	else q->cq_ring = mmap(0,q->cq_ring_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,q->ring,IORING_OFF_CQ_RING);
+
+	q->sq_entries = p.sq_entries;
+	q->sqes = mmap(0,p.sq_entries*sizeof(struct io_uring_sqe),PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,q->ring,IORING_OFF_SQES);
+
+	if(q->cq_ring==MAP_FAILED || q->sqes==MAP_FAILED) {
+		if(q->cq_ring!=MAP_FAILED && q->cq_ring!=q->sq_ring) munmap(q->cq_ring,q->cq_ring_size);
+		if(q->sqes!=MAP_FAILED) munmap(q->sqes,p.sq_entries*sizeof(struct io_uring_sqe));
+		munmap(q->sq_ring,q->sq_ring_size);
+		close(q->ring);
+		return -1;
+	}
+
+	q->sq_head = (unsigned *)((char *)q->sq_ring + p.sq_off.head);
+	q->sq_tail = (unsigned *)((char *)q->sq_ring + p.sq_off.tail);
+	q->sq_mask = (unsigned *)((char *)q->sq_ring + p.sq_off.ring_mask);
+	q->sq_array = (unsigned *)((char *)q->sq_ring + p.sq_off.array);
+	q->cq_head = (unsigned *)((char *)q->cq_ring + p.cq_off.head);
+	q->cq_tail = (unsigned *)((char *)q->cq_ring + p.cq_off.tail);
+	q->cq_mask = (unsigned *)((char *)q->cq_ring + p.cq_off.ring_mask);
+	q->cqes = (struct io_uring_cqe *)((char *)q->cq_ring + p.cq_off.cqes);
+
+	// registering is only a shortcut: without it every transfer names the file and the buffer itself
+	q->fixed_file = syscall(__NR_io_uring_register,q->ring,IORING_REGISTER_FILES,&q->disk->fd,1)==0;
+
+	if(memory) {
+		struct iovec iov = { memory, memory_size };
+		if(syscall(__NR_io_uring_register,q->ring,IORING_REGISTER_BUFFERS,&iov,1)==0) {
+			q->memory = memory;
+			q->memory_size = memory_size;
+		}
+	}
+
+	return 0;
+}
+
+
+
+/*
+Create a queue of up to "depth" transfers on the virtual disk "d".
+"memory" and "memory_size" give the memory most buffers are in, it is registered with the kernel. "memory" may be null.
+If io_uring is not available the queue still works, but transfers are only done when they are waited for.
+Returns a pointer to the new queue, or null on failure.
+*/
+struct disk_queue * disk_queue_create( struct disk *d, int depth, char *memory, long memory_size )
+{
+	struct disk_queue *q = calloc(1,sizeof(*q));
+	if(!q) return 0;
+
+	q->disk = d;
+	q->depth = depth>0 ? depth : 1;
+	q->requests = calloc(q->depth,sizeof(struct disk_request));
+	if(!q->requests) {
+		free(q);
+		return 0;
+	}
+
+	if(ring_setup(q,memory,memory_size)<0) q->ring = -1;
+
+	return q;
+}
+
+
+
+/* Return 1 if the transfers of a queue go through io_uring, 0 if they are done synchronously when waited for. */
+int disk_queue_async( struct disk_queue *q )
+{
+	return q->ring>=0;
+}
+
+
+
+/* A transfer completed with "result": finish what is left of it synchronously and mark it done. */
+static void complete_request( struct disk_queue *q, struct disk_request *r, int result )
+{
+	struct disk *d = q->disk;
+
+	if(result<0 && result!=-EINTR && result!=-EAGAIN) {
+		fprintf(stderr,"%s: failed to transfer block #%d: %s\n",r->write ? "disk_queue_write" : "disk_queue_read",r->block,strerror(-result));
+		abort();
+	}
+
+	// short or interrupted: transfer the rest here. Under O_DIRECT the rest is not aligned, so the whole block is moved again
+	if(result<d->block_size && d->direct) {
+		struct iovec iov = { r->data, d->block_size };
+		disk_transfer(d,r->block,&iov,1,r->write);
+	} else if(result<d->block_size) {
+		int offset = result>0 ? result : 0;
+		struct iovec iov = { r->data + offset, d->block_size - offset };
+		ssize_t actual;
+
+		while(iov.iov_len>0) {
+			off_t where = (off_t) r->block * d->block_size + (d->block_size - iov.iov_len);
+			actual = r->write ? pwritev(d->fd,&iov,1,where) : preadv(d->fd,&iov,1,where);
+			if(actual<0 && errno==EINTR) continue;
+			if(actual<=0) {
+				fprintf(stderr,"%s: failed to transfer block #%d: %s\n",r->write ? "disk_queue_write" : "disk_queue_read",r->block,actual<0 ? strerror(errno) : "end of file");
+				abort();
+			}
+			iov.iov_base = (char *)iov.iov_base + actual;
+			iov.iov_len -= actual;
+		}
+	}
+
+	r->state = REQUEST_DONE;
+	q->queued--;
+	q->done++;
+}
+
+
+
+/* Submit what is filled in and wait until at least "min" more transfers are complete. */
+static void collect( struct disk_queue *q, int min )
+{
+	int i;
+
+	if(q->ring<0) {
+		// without io_uring everything queued is done now, every run of consecutive blocks with one call
+		struct disk_io *io = malloc(sizeof(struct disk_io)*q->depth);
+		int n, write;
+
+		if(!io) {
+			fprintf(stderr,"disk_queue_wait: out of memory for %d blocks\n",q->depth);
+			abort();
+		}
+
+		for(write=0;write<=1;write++) {
+			for(n=0,i=0;i<q->depth;i++) {
+				if(q->requests[i].state==REQUEST_QUEUED && q->requests[i].write==write) {
+					io[n].block = q->requests[i].block;
+					io[n].data = q->requests[i].data;
+					n++;
+				}
+			}
+			disk_transfer_list(q->disk,io,n,write);
+		}
+
+		for(i=0;i<q->depth;i++) {
+			if(q->requests[i].state==REQUEST_QUEUED) complete_request(q,&q->requests[i],q->disk->block_size);
+		}
+
+		free(io);
+		return;
+	}
+
+	if(min>q->queued) min = q->queued;
+	if(min<0) min = 0;
+
+	while(q->to_submit>0 || min>0) {
+		int submitted = syscall(__NR_io_uring_enter,q->ring,q->to_submit,min,min>0 ? IORING_ENTER_GETEVENTS : 0,NULL,0);
+
+		if(submitted<0) {
+			if(errno==EINTR) continue;		// a signal came in, the timer of the sampling for one
+			fprintf(stderr,"disk_queue_wait: io_uring_enter failed: %s\n",strerror(errno));
+			abort();
+		}
+		q->to_submit -= submitted;
+
+		// reap every completion there is
+		unsigned head = *q->cq_head;
+		unsigned tail = __atomic_load_n(q->cq_tail,__ATOMIC_ACQUIRE);
+
+		for(;head!=tail;head++) {
+			struct io_uring_cqe *cqe = &q->cqes[head & *q->cq_mask];
+			complete_request(q,&q->requests[cqe->user_data],cqe->res);
+			if(min>0) min--;
+		}
+		__atomic_store_n(q->cq_head,head,__ATOMIC_RELEASE);
+	}
+}
+
+
+
+/* Queue a transfer of "block" to or from "data", to be handed back as "tag" once complete. */
+static void queue_request( struct disk_queue *q, int block, char *data, int write, long tag )
+{
+	struct disk *d = q->disk;
+	int i;
+
+	// if block is out of scope of this disk, give error
+	if(block<0 || block>=d->nblocks) {
+		fprintf(stderr,"%s: invalid block #%d\n",write ? "disk_queue_write" : "disk_queue_read",block);
+		abort();
+	}
+
+	// every slot is taken: wait for one to come free, its tag is kept until it is waited for
+	if(q->queued+q->done==q->depth) {
+		if(q->queued==0) {
+			fprintf(stderr,"%s: queue full of transfers not waited for\n",write ? "disk_queue_write" : "disk_queue_read");
+			abort();
+		}
+		collect(q,1);
+	}
+	for(i=0;q->requests[i].state!=REQUEST_FREE;i++);
+
+	struct disk_request *r = &q->requests[i];
+	r->state = REQUEST_QUEUED;
+	r->block = block;
+	r->data = data;
+	r->write = write;
+	r->tag = tag;
+	q->queued++;
+
+	if(q->ring<0) return;
+
+	// O_DIRECT cannot move an unaligned buffer: transfer it now, through an aligned copy
+	if(d->direct && (uintptr_t)data%DIRECT_ALIGN) {
+		struct iovec iov = { data, d->block_size };
+		disk_transfer(d,block,&iov,1,write);
+		complete_request(q,r,d->block_size);
+		return;
+	}
+
+	// fill in the next submission entry, it is submitted on the next wait
+	unsigned tail = *q->sq_tail;
+	unsigned index = tail & *q->sq_mask;
+	struct io_uring_sqe *sqe = &q->sqes[index];
+	int fixed = q->memory && data>=q->memory && data+d->block_size<=q->memory+q->memory_size;
+
+	memset(sqe,0,sizeof(*sqe));
+	if(fixed) sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+	else sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+	sqe->fd = q->fixed_file ? 0 : d->fd;
+	sqe->flags = q->fixed_file ? IOSQE_FIXED_FILE : 0;
+	sqe->addr = (unsigned long) data;
+	sqe->len = d->block_size;
+	sqe->off = (off_t) block * d->block_size;
+	sqe->buf_index = 0;
+	sqe->user_data = i;
+
+	q->sq_array[index] = index;
+	__atomic_store_n(q->sq_tail,tail+1,__ATOMIC_RELEASE);
+	q->to_submit++;
+}
+
+
+
+/*
+Queue a read of "block" into "data", to be handed back as "tag" once complete.
+"data" must not be touched until the read has been waited for.
+*/
+void disk_queue_read( struct disk_queue *q, int block, char *data, long tag )
+{
+	queue_request(q,block,data,0,tag);
+}
+
+
+
+/*
+Queue a write of "block" from "data", to be handed back as "tag" once complete.
+"data" must not change until the write has been waited for.
+*/
+void disk_queue_write( struct disk_queue *q, int block, const char *data, long tag )
+{
+	queue_request(q,block,(char *) data,1,tag);
+}
+
+
+
+/*
+Start every transfer queued, then wait until at least "min" of them are complete.
+Stores the tags of up to "max" complete transfers in "tags" and returns how many it stored.
+*/
+int disk_queue_wait( struct disk_queue *q, long *tags, int max, int min )
+{
+	int i, n = 0;
+
+	if(min>max) min = max;
+	if(q->to_submit>0 || q->done<min) collect(q,min-q->done);
+
+	for(i=0;i<q->depth && n<max;i++) {
+		if(q->requests[i].state==REQUEST_DONE) {
+			tags[n++] = q->requests[i].tag;
+			q->requests[i].state = REQUEST_FREE;
+			q->done--;
+		}
+	}
+
+	return n;
+}
+
+
+
+/* Return the number of transfers queued which have not been handed back by disk_queue_wait yet. */
+int disk_queue_pending( struct disk_queue *q )
+{
+	return q->queued + q->done;
+}
+
+
+
+/* Wait for every transfer of a queue to complete, then delete the queue. */
+void disk_queue_delete( struct disk_queue *q )
+{
+	if(q->queued>0) collect(q,q->queued);
+
+	if(q->ring>=0) {
+		if(q->cq_ring!=q->sq_ring) munmap(q->cq_ring,q->cq_ring_size);
+		munmap(q->sq_ring,q->sq_ring_size);
+		munmap(q->sqes,q->sq_entries*sizeof(struct io_uring_sqe));
+		close(q->ring);		// also drops the registered file and buffers
+	}
+
+	free(q->requests);
+	free(q);
+}
@@ -1,9 +1,3 @@
-
-/*
-Do not modify this file.
-Make all of your changes to main.c instead.
-*/
-
 #ifndef DISK_H
 #define DISK_H
 
@@ -11,6 +5,17 @@ Make all of your changes to main.c instead.
 
 
 
+/*
+The virtual disk the pages are swapped to: a file of fixed size blocks, one page each.
+Blocks are moved one at a time, as consecutive runs or scatter/gather lists with as few preadv/pwritev calls
+as possible, or through a queue of transfers in flight at once on io_uring. The file may be opened with
+O_DIRECT, so transfers go to the device instead of the host's page cache.
+All transfers on a disk without a queue are synchronous and may be made by several threads at once.
+*/
+struct disk;
+
+
+
 /*
 Create a new virtual disk in the file "filename", with the given number of blocks.
 Returns a pointer to a new disk object, or null on failure.
@@ -19,6 +24,16 @@ struct disk * disk_open( const char *filename, int blocks );
 
 
 
+/*
+Create a new virtual disk in the file "filename", with the given number of blocks, and open it with O_DIRECT:
+every transfer goes to the device instead of the host's page cache, so it costs what the device costs
+and the disk takes no memory of the host. Buffers need not be aligned, unaligned ones are copied.
+Returns a pointer to a new disk object, or null on failure, e.g. if the file system does not support O_DIRECT.
+*/
+struct disk * disk_open_direct( const char *filename, int blocks );
+
+
+
 /*
 Write exactly BLOCK_SIZE bytes to a given block on the virtual disk.
 "d" must be a pointer to a virtual disk, "block" is the block number,
@@ -37,6 +52,46 @@ void disk_read( struct disk *d, int block, char *data );
 
 
 
+/*
+Write "count" consecutive blocks starting at "block" from the buffers data[0] .. data[count-1],
+each BLOCK_SIZE bytes long, with as few system calls as possible.
+*/
+void disk_writev( struct disk *d, int block, char **data, int count );
+
+
+
+/*
+Read "count" consecutive blocks starting at "block" into the buffers data[0] .. data[count-1],
+each BLOCK_SIZE bytes long, with as few system calls as possible.
+*/
+void disk_readv( struct disk *d, int block, char **data, int count );
+
+
+
+/* One block of a scatter/gather list and the buffer it is transferred to or from. */
+struct disk_io {
+	int block;
+	char *data;
+};
+
+
+
+/*
+Write the blocks of a list, each from its own buffer.
+The list is sorted by block in place, and every run of consecutive blocks is written with one system call.
+*/
+void disk_write_list( struct disk *d, struct disk_io *io, int count );
+
+
+
+/*
+Read the blocks of a list, each into its own buffer.
+The list is sorted by block in place, and every run of consecutive blocks is read with one system call.
+*/
+void disk_read_list( struct disk *d, struct disk_io *io, int count );
+
+
+
 /*
 Return the number of blocks in the virtual disk.
 */
@@ -51,4 +106,62 @@ void disk_close( struct disk *d );
 
 
 
+/*
+A queue of transfers on the virtual disk which may be in flight at the same time, through io_uring where the kernel has it.
+Transfers are queued with disk_queue_read and disk_queue_write, started by disk_queue_wait, and handed back
+by it as their tags once complete. Without io_uring, they are done when they are waited for.
+A queue must only be used by one thread.
+*/
+struct disk_queue;
+
+
+
+/*
+Create a queue of up to "depth" transfers on the virtual disk "d".
+"memory" and "memory_size" give the memory most buffers are in, it is registered with the kernel. "memory" may be null.
+Returns a pointer to the new queue, or null on failure.
+*/
+struct disk_queue * disk_queue_create( struct disk *d, int depth, char *memory, long memory_size );
+
+
+
+/* Return 1 if the transfers of a queue go through io_uring, 0 if they are done synchronously when waited for. */
+int disk_queue_async( struct disk_queue *q );
+
+
+
+/*
+Queue a read of "block" into "data", to be handed back as "tag" once complete.
+"data" must not be touched until the read has been waited for.
+*/
+void disk_queue_read( struct disk_queue *q, int block, char *data, long tag );
+
+
+
+/*
+Queue a write of "block" from "data", to be handed back as "tag" once complete.
+"data" must not change until the write has been waited for.
+*/
+void disk_queue_write( struct disk_queue *q, int block, const char *data, long tag );
+
+
+
+/*
+Start every transfer queued, then wait until at least "min" of them are complete.
+Stores the tags of up to "max" complete transfers in "tags" and returns how many it stored.
+*/
+int disk_queue_wait( struct disk_queue *q, long *tags, int max, int min );
+
+
+
+/* Return the number of transfers queued which have not been handed back by disk_queue_wait yet. */
+int disk_queue_pending( struct disk_queue *q );
+
+
+
+/* Wait for every transfer of a queue to complete, then delete the queue. */
+void disk_queue_delete( struct disk_queue *q );
+
+
+
 #endif
@@ -0,0 +1,111 @@
+#include "frame_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+
+
+// structure holding the free frame bitmap
+struct frame_pool {
+	int nframes;		// no of frames in the physical memory
+	int nwords;		// no of 64 bit words in the bitmap
+	int nfree;		// no of free frames, so a full memory is known without looking at the bitmap
+	int hint;		// word where a free frame was last seen
+	uint64_t *free_bits;	// bit f%64 of word f/64 is 1 if frame f is free
+};
+
+
+
+/*
+Create a pool of "nframes" frames, all of them free.
+Returns a pointer to the new pool, or null on failure.
+*/
+struct frame_pool * frame_pool_create( int nframes )
+{
+	int i;
+	struct frame_pool *fp;
+
+	fp = malloc(sizeof(*fp));
+	if(!fp) return 0;
+
+	fp->nframes = nframes;
+	fp->nwords = (nframes + 63) / 64;
+	fp->nfree = nframes;
+	fp->hint = 0;
+	fp->free_bits = malloc(sizeof(uint64_t)*(fp->nwords>0 ? fp->nwords : 1));
+
+	if(!fp->free_bits) {
+		free(fp);
+		return 0;
+	}
+
+	// all frames are free, the bits past the last frame stay 0 so they are never handed out
+	for(i=0;i<fp->nwords;i++) fp->free_bits[i] = ~(uint64_t)0;
+	if(nframes % 64) fp->free_bits[fp->nwords-1] = ((uint64_t)1 << (nframes % 64)) - 1;
+
+	return fp;
+}
+
+
+
+/* Delete a pool and free its memory. */
+void frame_pool_delete( struct frame_pool *fp )
+{
+	free(fp->free_bits);
+	free(fp);
+}
+
+
+
+/* Take a free frame out of the pool. Returns the frame number, or -1 if every frame is in use. */
+int frame_pool_alloc( struct frame_pool *fp )
+{
+	int i;
+
+	if(fp->nfree==0) return -1;
+
+	// look for a word with a free frame, starting at the hint and wrapping around
+	for(i=0;i<fp->nwords;i++) {
+		int w = (fp->hint + i) % fp->nwords;
+
+		if(fp->free_bits[w]) {
+			int bit = __builtin_ctzll(fp->free_bits[w]);	// lowest free frame in this word
+
+			fp->free_bits[w] &= fp->free_bits[w] - 1;	// clear that bit
+			fp->nfree--;
+			fp->hint = w;
+			return w*64 + bit;
+		}
+	}
+
+	// cannot happen while nfree is right
+	return -1;
+}
+
+
+
+/* Give a frame back to the pool. The frame must be in use. */
+void frame_pool_free( struct frame_pool *fp, int frame )
+{
+	uint64_t bit = (uint64_t)1 << (frame % 64);
+
+	if(frame<0 || frame>=fp->nframes || (fp->free_bits[frame/64] & bit)) {
+		fprintf(stderr,"frame_pool_free: frame #%d is not in use\n",frame);
+		abort();
+	}
+
+	fp->free_bits[frame/64] |= bit;
+	fp->nfree++;
+
+	// the next allocation will find this frame straight away
+	fp->hint = frame/64;
+}
+
+
+
+/* Return the number of free frames in the pool. */
+int frame_pool_nfree( struct frame_pool *fp )
+{
+	return fp->nfree;
+}
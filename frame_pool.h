@@ -0,0 +1,44 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+
+
+/*
+A pool of free frames of the physical memory, kept as a bitmap with one bit per frame packed into 64 bit words.
+A free frame is found with a count-trailing-zeros instruction on the first non-empty word, starting from a hint
+which remembers where a free frame was last seen, so allocation is O(1) in the common case instead of a scan
+from frame 0. Frames can be given back when the page they hold is evicted or discarded.
+*/
+struct frame_pool;
+
+
+
+/*
+Create a pool of "nframes" frames, all of them free.
+Returns a pointer to the new pool, or null on failure.
+*/
+struct frame_pool * frame_pool_create( int nframes );
+
+
+
+/* Delete a pool and free its memory. */
+void frame_pool_delete( struct frame_pool *fp );
+
+
+
+/* Take a free frame out of the pool. Returns the frame number, or -1 if every frame is in use. */
+int frame_pool_alloc( struct frame_pool *fp );
+
+
+
+/* Give a frame back to the pool. The frame must be in use. */
+void frame_pool_free( struct frame_pool *fp, int frame );
+
+
+
+/* Return the number of free frames in the pool. */
+int frame_pool_nfree( struct frame_pool *fp );
+
+
+
+#endif
@@ -0,0 +1,136 @@
+#include "lru.h"
+
+#include <stdlib.h>
+
+
+
+// structure holding a doubly linked recency list indexed by page number
+// slot "npages" is a sentinel, so the list is circular and never has null links
+struct lru_list {
+	int npages;		// no of pages the list can hold
+	int size;		// no of pages currently in the list
+	int *prev;		// prev[page] is the page used just before it, -1 if page not in list
+	int *next;		// next[page] is the page used just after it
+};
+
+
+
+/*
+Create an empty recency list able to hold the pages 0 .. npages-1.
+Returns a pointer to the new list, or null on failure.
+*/
+struct lru_list * lru_create( int npages )
+{
+	int i;
+	struct lru_list *l;
+
+	l = malloc(sizeof(*l));
+	if(!l) return 0;
+
+	l->npages = npages;
+	l->size = 0;
+
+	// one extra slot for the sentinel
+	l->prev = malloc(sizeof(int)*(npages+1));
+	l->next = malloc(sizeof(int)*(npages+1));
+
+	if(!l->prev || !l->next) {
+		free(l->prev);
+		free(l->next);
+		free(l);
+		return 0;
+	}
+
+	// no page is in the list initially
+	for(i=0;i<npages;i++) l->prev[i] = -1;
+
+	// empty list: the sentinel points to itself
+	l->prev[npages] = npages;
+	l->next[npages] = npages;
+
+	return l;
+}
+
+
+
+/* Delete a recency list and free its memory. */
+void lru_delete( struct lru_list *l )
+{
+	free(l->prev);
+	free(l->next);
+	free(l);
+}
+
+
+
+/* Insert a page at the most recently used end of the list. The page must not already be in the list. */
+void lru_insert( struct lru_list *l, int page )
+{
+	int s = l->npages;	// sentinel
+	int last = l->prev[s];	// current most recently used page
+
+	// link the page between the current tail and the sentinel
+	l->prev[page] = last;
+	l->next[page] = s;
+	l->next[last] = page;
+	l->prev[s] = page;
+
+	l->size++;
+}
+
+
+
+/* Remove a page from the list. Does nothing if the page is not in the list. */
+void lru_remove( struct lru_list *l, int page )
+{
+	int p = l->prev[page];
+
+	if(p<0) return;		// page not in list
+
+	// unlink the page from its neighbours
+	l->next[p] = l->next[page];
+	l->prev[l->next[page]] = p;
+
+	l->prev[page] = -1;
+	l->size--;
+}
+
+
+
+/* Move a page to the most recently used end of the list. Does nothing if the page is not in the list. */
+void lru_touch( struct lru_list *l, int page )
+{
+	// page not in list or already the most recently used one
+	if(l->prev[page]<0 || l->next[page]==l->npages) return;
+
+	lru_remove(l, page);
+	lru_insert(l, page);
+}
+
+
+
+/* Return the least recently used page in the list, or -1 if the list is empty. */
+int lru_oldest( struct lru_list *l )
+{
+	int first = l->next[l->npages];
+
+	if(first==l->npages) return -1;		// only the sentinel is left
+
+	return first;
+}
+
+
+
+/* Return 1 if the page is in the list, 0 otherwise. */
+int lru_contains( struct lru_list *l, int page )
+{
+	return l->prev[page]>=0;
+}
+
+
+
+/* Return the number of pages currently in the list. */
+int lru_size( struct lru_list *l )
+{
+	return l->size;
+}
@@ -0,0 +1,58 @@
+#ifndef LRU_H
+#define LRU_H
+
+
+
+/*
+A recency list over the pages of the virtual memory.
+Every page owns a fixed slot in the list, so inserting, touching and removing
+a page are all constant time operations instead of a walk over the list.
+*/
+struct lru_list;
+
+
+
+/*
+Create an empty recency list able to hold the pages 0 .. npages-1.
+Returns a pointer to the new list, or null on failure.
+*/
+struct lru_list * lru_create( int npages );
+
+
+
+/* Delete a recency list and free its memory. */
+void lru_delete( struct lru_list *l );
+
+
+
+/* Insert a page at the most recently used end of the list. The page must not already be in the list. */
+void lru_insert( struct lru_list *l, int page );
+
+
+
+/* Remove a page from the list. Does nothing if the page is not in the list. */
+void lru_remove( struct lru_list *l, int page );
+
+
+
+/* Move a page to the most recently used end of the list. Does nothing if the page is not in the list. */
+void lru_touch( struct lru_list *l, int page );
+
+
+
+/* Return the least recently used page in the list, or -1 if the list is empty. */
+int lru_oldest( struct lru_list *l );
+
+
+
+/* Return 1 if the page is in the list, 0 otherwise. */
+int lru_contains( struct lru_list *l, int page );
+
+
+
+/* Return the number of pages currently in the list. */
+int lru_size( struct lru_list *l );
+
+
+
+#endif
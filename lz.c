@@ -0,0 +1,165 @@
+#include "lz.h"
+
+#include <string.h>
+
+
+
+#define LZ_MIN_MATCH	4		// shortest match worth an offset
+#define LZ_MAX_OFFSET	65535		// offsets take 2 bytes
+#define LZ_HASH_BITS	12		// the hash table has 1 << LZ_HASH_BITS entries
+
+
+
+/* Hash the 4 bytes at "p" to an index into the hash table. */
+static unsigned hash4( const unsigned char *p )
+{
+	unsigned v;
+
+	memcpy(&v, p, 4);
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+
+
+/* Store a length of "len" at "out" + "*o" as bytes of 255 and a last byte below 255. Returns -1 if it does not fit. */
+static int put_length( unsigned char *out, int *o, int cap, int len )
+{
+	while(len >= 255) {
+		if(*o >= cap) return -1;
+		out[(*o)++] = 255;
+		len -= 255;
+	}
+
+	if(*o >= cap) return -1;
+	out[(*o)++] = len;
+
+	return 0;
+}
+
+
+
+/*
+Append a sequence of "nlit" literals at "lit" followed by a match of "len" bytes "offset" back, or no match if "len" is 0.
+Returns -1 if it does not fit.
+*/
+static int put_sequence( unsigned char *out, int *o, int cap, const unsigned char *lit, int nlit, int offset, int len )
+{
+	int mlen = len ? len - LZ_MIN_MATCH : 0;
+
+	if(*o >= cap) return -1;
+	out[(*o)++] = ((nlit < 15 ? nlit : 15) << 4) | (mlen < 15 ? mlen : 15);
+
+	if(nlit >= 15 && put_length(out, o, cap, nlit - 15) < 0) return -1;
+
+	if(*o + nlit > cap) return -1;
+	memcpy(out + *o, lit, nlit);
+	*o += nlit;
+
+	if(!len) return 0;
+
+	if(*o + 2 > cap) return -1;
+	out[(*o)++] = offset & 0xff;
+	out[(*o)++] = offset >> 8;
+
+	if(mlen >= 15 && put_length(out, o, cap, mlen - 15) < 0) return -1;
+
+	return 0;
+}
+
+
+
+/*
+Compress "n" bytes at "src" into "dst", which has room for "cap" bytes.
+Returns the size of the compressed data, or 0 if it does not fit in "cap" bytes.
+*/
+int lz_compress( const char *src, int n, char *dst, int cap )
+{
+	const unsigned char *in = (const unsigned char *) src;
+	unsigned char *out = (unsigned char *) dst;
+	int table[1 << LZ_HASH_BITS];		// last position of every hash, plus 1, 0 if none
+	int i = 0, anchor = 0, o = 0;
+
+	memset(table, 0, sizeof(table));
+
+	while(i + LZ_MIN_MATCH <= n) {
+		unsigned h = hash4(in + i);
+		int candidate = table[h] - 1;
+
+		table[h] = i + 1;
+
+		if(candidate < 0 || i - candidate > LZ_MAX_OFFSET || memcmp(in + candidate, in + i, LZ_MIN_MATCH)) {
+			i++;
+			continue;
+		}
+
+		// extend the match as far as it goes, it may run into the bytes it copies
+		int len = LZ_MIN_MATCH;
+		while(i + len < n && in[candidate + len] == in[i + len]) len++;
+
+		if(put_sequence(out, &o, cap, in + anchor, i - anchor, i - candidate, len) < 0) return 0;
+
+		i += len;
+		anchor = i;
+	}
+
+	if(put_sequence(out, &o, cap, in + anchor, n - anchor, 0, 0) < 0) return 0;
+
+	return o;
+}
+
+
+
+/* Read a length continued in bytes of 255 at "in" + "*i" and add it to "*len". Returns -1 if it runs past "n". */
+static int get_length( const unsigned char *in, int *i, int n, int *len )
+{
+	unsigned char b;
+
+	do {
+		if(*i >= n) return -1;
+		b = in[(*i)++];
+		*len += b;
+	} while(b == 255);
+
+	return 0;
+}
+
+
+
+/*
+Decompress "n" bytes of compressed data at "src" into "dst", which has room for "cap" bytes.
+Returns the size of the decompressed data, or -1 if the data is corrupt or does not fit in "cap" bytes.
+*/
+int lz_decompress( const char *src, int n, char *dst, int cap )
+{
+	const unsigned char *in = (const unsigned char *) src;
+	unsigned char *out = (unsigned char *) dst;
+	int i = 0, o = 0;
+
+	while(i < n) {
+		int token = in[i++];
+		int nlit = token >> 4;
+		int len = token & 15;
+
+		if(nlit == 15 && get_length(in, &i, n, &nlit) < 0) return -1;
+		if(i + nlit > n || o + nlit > cap) return -1;
+		memcpy(out + o, in + i, nlit);
+		i += nlit;
+		o += nlit;
+
+		if(i == n) break;		// the last sequence has no match
+
+		if(i + 2 > n) return -1;
+		int offset = in[i] | (in[i+1] << 8);
+		i += 2;
+
+		if(len == 15 && get_length(in, &i, n, &len) < 0) return -1;
+		len += LZ_MIN_MATCH;
+
+		if(offset == 0 || offset > o || o + len > cap) return -1;
+
+		// byte by byte: the match may overlap the bytes it produces
+		for(int k=0; k < len; k++, o++) out[o] = out[o - offset];
+	}
+
+	return o;
+}
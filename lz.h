@@ -0,0 +1,32 @@
+#ifndef LZ_H
+#define LZ_H
+
+
+
+/*
+A small LZ77 compressor in the style of LZ4, fast enough to compress a page on every eviction.
+The output is a series of sequences: a token byte holding the number of literals in its high 4 bits and the length
+of the match after them, less 4, in its low 4 bits, then more length bytes if either was 15 or more, the literals,
+and the 2 byte offset of the match back into the output. The last sequence has literals only.
+Matches are found through a hash table of the last position of every 4 byte string, so each byte costs a lookup.
+*/
+
+
+
+/*
+Compress "n" bytes at "src" into "dst", which has room for "cap" bytes.
+Returns the size of the compressed data, or 0 if it does not fit in "cap" bytes.
+*/
+int lz_compress( const char *src, int n, char *dst, int cap );
+
+
+
+/*
+Decompress "n" bytes of compressed data at "src" into "dst", which has room for "cap" bytes.
+Returns the size of the decompressed data, or -1 if the data is corrupt or does not fit in "cap" bytes.
+*/
+int lz_decompress( const char *src, int n, char *dst, int cap );
+
+
+
+#endif
@@ -23,56 +23,193 @@ how to use the page table and disk interfaces.
 
 #include "page_table.h"
 #include "disk.h"
+#include "policy.h"
+#include "opt.h"
+#include "mrc.h"
+#include "shards.h"
+#include "frame_pool.h"
+#include "trace.h"
+#include "replay.h"
+#include "ztier.h"
+#include "swap_map.h"
 #include "time.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sched.h>
+
+
+
+// command line usage
+const char *usage = "use: virtmem <npages> <nframes> <rand|fifo|custom|aging|clock|eclock|arc|2q|opt|mrc> <sort|scan|focus|mixed|replay> [-sample <usec>] [-batch <frames>] [-trace <file>] [-tracemmap] [-shards <rate>] [-shardsmax <pages>] [-flush <frames>] [-readahead <pages>] [-uring] [-direct] [-zerofill] [-ztier <kbytes>] [-swapmap] [-reclaim <frames>] [-uffd] [-threads <n>]\n";
 
 
 
 // Global Variables
 int nframes; // stores total number of frames
-int *is_frame_occup_struc = NULL; // pointer to free frame data struc
+struct frame_pool *free_frames = NULL; // pool of free frames
 int *frame_holds_what = NULL;		// array to maintain which frame holds which physical page
 char *PRAlgoToUse;				// store which page replacement algorithm to use 
+const struct policy *policy = NULL;	// the page replacement algorithm, looked up once from PRAlgoToUse
+int trackAccesses = 0;			// 1 if the programs must report every access to the page replacement algorithm
+int lastAccessedPage = -1;		// page of the last access reported or faulted on, repeated accesses to it are one reference
+int lastAccessWrite = 0;		// 1 if the last reference to lastAccessedPage was a write
+int sampleInterval = 0;			// reference sampling interval in microseconds, 0 if sampling is off
+int sampleBatch = 0;			// no of frames sampled per tick
 
 char *virtmem = NULL;
 char *physmem = NULL;
 struct disk *disk = NULL; // global pointer to disk
+struct page_table *pagetable = NULL; // global pointer to page table, for the policy host
+struct trace *trace = NULL;		// page reference trace being recorded, null if tracing is off
 
 
 
-// data struct for fifo
-int oldest_page = 0;
-int newest_page = 0;
-int *fifo_page_queue = NULL;
+// data struct for OPT: the page-reference string recorded while the program runs
+int *opt_refs = NULL;
+int opt_nrefs = 0;
+int opt_refs_size = 0;
+#define RECORD_WINDOW 2			// no of pages the program can access without a fault while recording
+int recordWindow[RECORD_WINDOW];	// those pages, the most recently referenced first, -1 if none
+int recordWindowRef[RECORD_WINDOW];	// index in opt_refs of the last reference to each of them
+char *recordLoaded = NULL;			// 1 if the page has been read from disk into its frame while recording
 
 
 
-// data struct for LRU
-struct page_node
-{
-	int page;
-	struct page_node *nextPage;
-}*head, *tail, *currPage, *newPage, *prevPage;
+// data struct for the miss-ratio curve: exact, or estimated from a sample of the pages if -shards or -shardsmax is given
+struct mrc *lruCurve = NULL;
+struct shards *sampledCurve = NULL;
+double shardsRate = 0;			// rate at which pages are sampled
+int shardsMax = 0;				// most pages sampled at once, 0 for a fixed rate
+
+
+
+// data struct for the write-back flusher
+int flushClean = 0;				// no of frames the flusher tries to keep clean, 0 if there is no flusher
+int dirtyFrames = 0;			// no of frames holding a page which has been written since it was brought in
+char *frameWriteback = NULL;	// 1 while the flusher writes out the page held by a frame
+volatile int flusherStop = 0;	// set to 1 to make the flusher return
+pthread_t flusher;
+#define FLUSH_BATCH 16			// most dirty frames the flusher writes out at once
+
+
+
+// data struct for read-ahead
+int readAheadMax = 0;			// most pages read ahead at once, 0 if read-ahead is off
+int readAheadWindow = 0;		// no of pages read ahead on the next fault of a stream
+int lastFaultPage = -1;			// page of the last fault which read a page in
+int lastFaultDelta = 0;			// distance between the last two such faults
+int streamStride = 0;			// distance between the pages of the stream being read ahead, 0 if there is none
+int streamNext = -1;			// first page after the last batch read ahead, where the stream faults next
+int batchStart = 0;				// first page of the last batch read ahead
+int batchCount = 0;				// no of pages in the last batch, including ones skipped as already resident
+char *prefetched = NULL;		// 1 if a page was read ahead and has not been used yet
+
+
+
+// data struct for the disk transfers of a fault: the page faulted on and the pages read ahead are read together
+int useQueue = 0;					// 1 to keep several transfers in flight at once through io_uring
+struct disk_queue *faultQueue = NULL;	// transfers of the page fault handler, null if useQueue is 0
+static __thread struct disk_queue *threadQueue = NULL;	// transfers of the faults of this thread of the program, with several
+struct disk_queue *flushQueue = NULL;	// transfers of the flusher, null if useQueue is 0
+struct disk_io *pageIns = NULL;		// pages being read in by the current fault and the frames they go to
+int nPageIns = 0;
+int directIO = 0;					// 1 to open the disk with O_DIRECT, past the page cache of the host
+
+
+
+// data struct for zero-fill-on-demand: memory starts out zeroed, and a page is only on disk once something else was written to it
+int zeroFill = 0;				// 1 to zero-fill pages without backing data instead of reading them
+unsigned char *pageBacked = NULL;	// bitmap of the pages whose disk block holds their contents
+#define PAGE_BACKED(page) ((pageBacked[(page)/8] >> ((page)%8)) & 1)
+#define SET_PAGE_BACKED(page, v) (pageBacked[(page)/8] = (pageBacked[(page)/8] & ~(1 << ((page)%8))) | ((v) << ((page)%8)))
+
+
+
+// data struct for the compressed tier: evicted pages are kept compressed in memory, and only go to disk when it is full
+struct ztier *tier = NULL;		// null if there is no tier
+long tierBudget = 0;			// most memory the tier takes, in bytes
+
+
+
+// data struct for the swap-slot map: a page is written to the next slot of a log on disk instead of its own block
+struct swap_map *swapMap = NULL;	// null if pages are always in the block with their own number
+int useSwapMap = 0;				// 1 to place pages through the swap-slot map
+
+
+
+// data struct for batched eviction: frames are taken from their pages, then written and unmapped together
+int reclaimHigh = 0;			// no of free frames a fault which finds none reclaims, 0 to evict one page at a time
+char *frameReclaiming = NULL;	// 1 while the page held by a frame is being evicted
+int *evictPages = NULL;			// pages being evicted
+int *evictFrames = NULL;		// and the frames they are in
+struct disk_io *evictWrites = NULL;	// dirty pages being evicted and the blocks they go to
+int nEvicting = 0;
+int nEvictWrites = 0;
+int userFault = 0;				// 1 to take page faults from a userfaultfd instead of SIGSEGV
+
+
+
+// data struct for threads: the program runs in several threads at once, each on its own part of the memory
+int nThreads = 1;				// no of threads running the program
+char *frameReading = NULL;		// 1 while a fault reads a page into a frame without holding the lock of the page table
+int frameWaits = 0;				// no of times a fault waited for a frame another thread was reading or writing
+int missPage = -1;				// page of the fault which is evicting, until its page is inserted, -1 if none
+
+
+
+// histogram of the time spent in page_fault_handler
+#define LATENCY_BUCKET_NS 100	// width of a bucket
+#define LATENCY_BUCKETS 100000	// up to 10 ms, slower faults are counted in the last bucket
+int faultLatency[LATENCY_BUCKETS];
 
 
 
 // Variables used to track statistics to print at the end
 int pageFaults = 0;
+int writeFaultsAvoided = 0;		// no of writes to a page not in memory which mapped it writable on the first fault
 int diskReads = 0;
 int diskWrites = 0;
+int flusherWrites = 0;
+int readAheadPages = 0;			// no of pages read ahead
+int readAheadHits = 0;			// no of pages read ahead which were then used
+int readAheadWaste = 0;			// no of pages read ahead which were evicted without being used
+int reclaimBatches = 0;			// no of batches of evictions
+int reclaimFrames = 0;			// no of frames evicted in them
+int unmapCalls = 0;				// no of system calls made to unmap evicted pages
+int tierSpillWrites = 0;		// no of dirty pages written to disk when they were spilled from the tier
+int zeroFillReads = 0;			// no of disk reads avoided by zero-filling a page
+int zeroDropWrites = 0;			// no of disk writes avoided by dropping an all-zero page
 
 
 
 // function definitions
-int findnset_free_frame(int *is_frame_occup_struc,int nframes);
-void random_pra( struct page_table *pt, int page );
-void fifo_pra( struct page_table *pt, int page);
-void custom_pra( struct page_table *pt, int page);
-void replace_page( struct page_table *pt, int page, int frame_no_toremove );
+void evict_frame( struct page_table *pt, int frame );
+void detach_frame( struct page_table *pt, int frame );
+void finish_evictions( struct page_table *pt );
+void reclaim_frames( struct page_table *pt, int page );
+int get_frame( struct page_table *pt, int page );
+void *flusher_thread( void *arg );
+void read_ahead( struct page_table *pt, int page );
+void page_in( int page, int frame );
+void finish_page_ins( struct page_table *pt );
+struct disk_queue * fault_queue();
+void tier_spill( int page, const char *data, int dirty );
+int page_block( int page );
+int write_block( int page );
+int frame_is_zero( int frame );
+double fault_latency_percentile( double p );
+int run_program( const char *program, char *data, int length );
+void run_threads( const char *program, char *data, int npages );
+int run_offline( int npages, int nframes, const char *program );
+void start_curve( int npages, int maxframes );
+void curve_reference( int page );
+void print_curve( int maxframes );
+int run_replay( int nframes, const char *filename );
 
 
 
@@ -80,7 +217,8 @@ void replace_page( struct page_table *pt, int page, int frame_no_toremove );
 void scan_program( char *data, int length );
 void sort_program( char *data, int length );
 void focus_program( char *data, int length );
-void rearrange_page_list(int i);
+void mixed_program( char *data, int length );
+void page_accessed(int i, int write);
 static int compare_bytes( const void *pa, const void *pb );
 
 
@@ -170,13 +308,19 @@ void page_fault_handler( struct page_table *pt, int page )
 /**************** Version 4 of Page Fault Handler ***********************/
 /* This function handles the page faults generated while accessing the memory
 
-	In this version the entry is first given only the read access and then is required write access is given
+	In this version the entry is first given only the read access and then is required write access is given,
+	unless the fault says it was a write: then the page is mapped writable at once and the second fault is saved
 */
-void page_fault_handler( struct page_table *pt, int page )
+void page_fault_handler( struct page_table *pt, int page, int write )
 {
 //    printf("page fault on page #%d\n",page); // print this virtual page is needed
 
+	struct timespec faultStart, faultEnd;
+	clock_gettime(CLOCK_MONOTONIC, &faultStart);
+
 	pageFaults++;							//increment page faults
+	int newReference = page != lastAccessedPage;	// 0 if the fault comes from the reference just before, e.g. a write after the read fault
+	lastAccessedPage = page;				// the access which faulted is the reference to this page, do not count it again
 
 	// variables to store information about the page on which page fault has occured
     int curr_bits;
@@ -184,86 +328,77 @@ void page_fault_handler( struct page_table *pt, int page )
     
 	// get the details of the page table entry corresponding to the page i.e. which frame does it hold and what are the permission bits
     page_table_get_entry( pt, page, &curr_frame, &curr_bits ); 
+
+	// a fault on a readable page writes it, a fault on a page without any access reads it unless it says otherwise
+	lastAccessWrite = write || (curr_bits & PROT_READ) != 0;
+	if ( trace ) trace_record(trace, curr_bits ? TRACE_FAULT_PROT : TRACE_FAULT_MAJOR, page, lastAccessWrite);
        
 
     // FAULT TYPE 1 - page not in virtual memory i.e. no protection bits set i.e. entry in page table is free 
     if ( ( (curr_bits & PROT_READ)==0 ) && ( (curr_bits & PROT_WRITE)==0 ) && ( (curr_bits & PROT_EXEC)==0 ) )
     {
-		// find a free frame
-		int free_loc = findnset_free_frame(is_frame_occup_struc, nframes);
+		// the other threads wait for the page instead of bringing it in too, also while this fault waits for a frame or the disk
+		if ( nThreads > 1 ) page_table_hold(pt, page);
 
-		if (free_loc != -1) // have found a free frame. Bring page in that free frame
-		{
-			// set an entry of page in page table to free_loc frame location and give read access to it
-			page_table_set_entry(pt, page, free_loc, 0|PROT_READ);
+		// find a free frame. If all frames all full, some page is kicked out of its frame: the page replacement algorithm given by the user says which one
+		int free_loc = get_frame(pt, page);
 
-			// if fifo then need to store this frame in queue 
-			if ( !strcmp(PRAlgoToUse, "fifo") )
-			{
-				fifo_page_queue[newest_page] = free_loc;
-				newest_page = (newest_page + 1) % nframes;		// make it a circular queue
-			}
+		// Bring page in the free frame:
+		// set an entry of page in page table to free_loc frame location and give read access to it
+		page_table_set_entry(pt, page, free_loc, 0|PROT_READ);
 
-			// if LRU then create a new node for this page in page list
-			if ( !strcmp(PRAlgoToUse, "custom") )
-			{
-				newPage = (struct page_node *) malloc(sizeof(struct page_node));
-				newPage->page = page;
-				newPage->nextPage = NULL;
-	
-				if (head == NULL)
-				{
-					head = newPage;
-					tail = head;
-				}
-				else
-				{
-					tail->nextPage = newPage;
-					tail = newPage;
-				}
-			}
-	
-			// Read data from disk at virtual address given by 'page' to physical memory frame
-			disk_read(disk, page, &physmem[free_loc*PAGE_SIZE]);
-			diskReads++;
+		// Read data from disk at virtual address given by 'page' to physical memory frame, together with the pages read ahead
+		page_in(page, free_loc);
 
-			// Store info that this page is held in which page frame.
-			// this frame holds this page, inverse of page table.
-			frame_holds_what[free_loc] = page; 
-		}
+		// Store info that this page is held in which page frame.
+		// this frame holds this page, inverse of page table.
+		frame_holds_what[free_loc] = page; 
 
-		else		// all frames all full. Need to kick out some page from some frame. Will need page replacement algorithm. Call the page replacement algorithm given by the user.
-		{ 
-			if (!strcmp(PRAlgoToUse, "rand"))
-			{
-				random_pra(pt, page);
-			}
+		// tell the page replacement algorithm where the page is now, which ends the miss
+		policy->on_insert(page, free_loc);
+		if ( missPage == page ) missPage = -1;
 
-			else if (!strcmp(PRAlgoToUse, "fifo"))
-			{
-				fifo_pra(pt, page);
-			}
-			
-			else if (!strcmp(PRAlgoToUse, "custom"))
-			{
-				custom_pra(pt, page);
-			}
+		// the program may be going through the memory in order: bring in the next pages as well
+		if ( readAheadMax > 0 ) read_ahead(pt, page);
 
-			else //check for incorrect policy name
-			{
-				printf("use: virtmem <npages> <nframes> <rand|fifo|custom> <sort|scan|focus>\n");
-				exit(1);
-			}			
+		// the program must not run before its pages are in memory
+		finish_page_ins(pt);
+
+		// a write: make the page writable now instead of on a second fault, unless it came back dirty from the tier.
+		// The copy on disk is out of date, its slot is freed once it is read
+		page_table_get_entry(pt, page, &curr_frame, &curr_bits);
+		if ( write && curr_bits == PROT_READ )
+		{
+			page_table_set_entry(pt, page, curr_frame, PROT_READ|PROT_WRITE);
+			dirtyFrames++;
+			if ( swapMap ) swap_map_release(swapMap, page);
+			writeFaultsAvoided++;
 		}
+
+		if ( nThreads > 1 ) page_table_release(pt, page);
     }
 
     else // FAULT TYPE 2 - page is in virtual memory but does not have necessary permissions
     {
+		// the faulting access is a hit as far as the page replacement algorithm is concerned
+		if ( newReference && policy->on_access ) policy->on_access(page);
+
+		// a write to a page read ahead is its first use
+		if ( prefetched && prefetched[page] )
+		{
+			prefetched[page] = 0;
+			readAheadHits++;
+		}
+
 		// dont have write permission but has read
 		if ( ( (curr_bits & PROT_WRITE)==0 ) && ( ( curr_bits & PROT_READ ) ==1 ) )
 		{
 			//OR curr_bits with PROC masks to get 1's at req positions.		   
 			page_table_set_entry( pt, page, curr_frame, curr_bits | PROT_WRITE);  
+			dirtyFrames++;
+
+			// the copy on disk is out of date: free its slot, unless the flusher is still writing it
+			if ( swapMap && !(frameWriteback && frameWriteback[curr_frame]) ) swap_map_release(swapMap, page);
 		}
 
 		else // has write but not read, may happen though unlikely
@@ -276,15 +411,61 @@ void page_fault_handler( struct page_table *pt, int page )
 // For testing purpose
 //	page_table_print(pt);
 
+	clock_gettime(CLOCK_MONOTONIC, &faultEnd);
+	long ns = (faultEnd.tv_sec - faultStart.tv_sec) * 1000000000L + (faultEnd.tv_nsec - faultStart.tv_nsec);
+	faultLatency[ ns/LATENCY_BUCKET_NS < LATENCY_BUCKETS ? ns/LATENCY_BUCKET_NS : LATENCY_BUCKETS-1 ]++;
 } 
 
 
 
+/* The policy host of the live run: answers the page replacement algorithm's questions from the page table */
+static int live_frame_page( int frame )
+{
+	return frame_holds_what[frame];
+}
+
+static int live_page_frame( int page )
+{
+	int frame, bits;
+	page_table_get_entry(pagetable, page, &frame, &bits);
+	return frame;
+}
+
+static int live_is_dirty( int page )
+{
+	int frame, bits;
+	page_table_get_entry(pagetable, page, &frame, &bits);
+	return (bits & PROT_WRITE) != 0;
+}
+
+static int live_test_and_clear_ref( int page )
+{
+	// a page being evicted by this fault is not to be picked again
+	if ( frameReclaiming[live_page_frame(page)] ) return 1;
+	return page_table_test_and_clear_ref(pagetable, page);
+}
+
+static int live_get_age( int page )
+{
+	if ( frameReclaiming[live_page_frame(page)] ) return 0x1ff;		// older than any aging counter with its referenced bit
+	return page_table_get_age(pagetable, page);
+}
+
+const struct policy_host live_host = {
+	live_frame_page,
+	live_page_frame,
+	live_is_dirty,
+	live_test_and_clear_ref,
+	live_get_age,
+};
+
+
+
 int main( int argc, char *argv[] )
 {
 	// check if all command line arguments are given
-	if(argc!=5) {
-		printf("use: virtmem <npages> <nframes> <rand|fifo|custom> <sort|scan|focus>\n");
+	if(argc<5) {
+		printf("%s", usage);
 		return 1;
 	}
 
@@ -294,10 +475,88 @@ int main( int argc, char *argv[] )
 	PRAlgoToUse = argv[3];			// store which page replacement algorithm to use 
 	const char *program = argv[4];	// store which testing program to run
 
+	const char *traceFile = NULL;
+	int traceMmap = 0;
+
+	// optional arguments
+	for(int i=5; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-sample") && i+1 < argc) {
+			sampleInterval = atoi(argv[++i]);	// sample references every so many microseconds
+		} else if(!strcmp(argv[i], "-batch") && i+1 < argc) {
+			sampleBatch = atoi(argv[++i]);		// no of frames to sample per tick
+		} else if(!strcmp(argv[i], "-trace") && i+1 < argc) {
+			traceFile = argv[++i];				// record every reference and fault into this file
+		} else if(!strcmp(argv[i], "-tracemmap")) {
+			traceMmap = 1;						// store the trace through a mapping of the file instead of write()
+		} else if(!strcmp(argv[i], "-shards") && i+1 < argc) {
+			shardsRate = atof(argv[++i]);		// estimate the miss-ratio curve from this fraction of the pages
+		} else if(!strcmp(argv[i], "-shardsmax") && i+1 < argc) {
+			shardsMax = atoi(argv[++i]);		// estimate the miss-ratio curve from at most this many pages
+		} else if(!strcmp(argv[i], "-flush") && i+1 < argc) {
+			flushClean = atoi(argv[++i]);		// write back dirty pages in the background to keep this many frames clean
+		} else if(!strcmp(argv[i], "-readahead") && i+1 < argc) {
+			readAheadMax = atoi(argv[++i]);		// read ahead up to this many pages on faults of a sequential or strided stream
+		} else if(!strcmp(argv[i], "-uring")) {
+			useQueue = 1;						// read and write pages through io_uring, several at a time
+		} else if(!strcmp(argv[i], "-direct")) {
+			directIO = 1;						// read and write pages on the device, not in the host's page cache
+		} else if(!strcmp(argv[i], "-ztier") && i+1 < argc) {
+			tierBudget = atol(argv[++i]) * 1024;	// keep evicted pages compressed in up to this much memory
+		} else if(!strcmp(argv[i], "-swapmap")) {
+			useSwapMap = 1;						// write pages one after the other into a log of slots on disk
+		} else if(!strcmp(argv[i], "-reclaim") && i+1 < argc) {
+			reclaimHigh = atoi(argv[++i]);		// when memory is full, evict pages in batches to free this many frames
+		} else if(!strcmp(argv[i], "-uffd")) {
+			userFault = 1;				// faults are handled by a thread reading them from a userfaultfd
+		} else if(!strcmp(argv[i], "-threads") && i+1 < argc) {
+			nThreads = atoi(argv[++i]);			// run the program in this many threads, each on its own part of the memory
+		} else if(!strcmp(argv[i], "-zerofill")) {
+			zeroFill = 1;						// memory starts zeroed: never read pages which were never written
+		} else {
+			printf("%s", usage);
+			return 1;
+		}
+	}
+
+	// replay a recorded trace instead of running a program: no page table, no signals
+	if ( !strcmp(program, "replay") )
+	{
+		if ( traceFile == NULL )
+		{
+			printf("replay needs the trace to replay: -trace <file>\n");
+			return 1;
+		}
+		return run_replay(nframes, traceFile);
+	}
+
+	// OPT needs to know the future and the miss-ratio curve needs every reference: record the whole run first, then replay it
+	if ( !strcmp(PRAlgoToUse, "opt") || !strcmp(PRAlgoToUse, "mrc") )
+	{
+		return run_offline(npages, nframes, program);
+	}
+
+	// look up the page replacement algorithm once, from now on it is only called through its function pointers
+	policy = policy_find(PRAlgoToUse);
+	if ( policy == NULL )
+	{
+		printf("%s", usage);
+		return 1;
+	}
+
+	// the programs only report their accesses if the algorithm or the trace wants them
+	trackAccesses = policy->on_access != NULL || traceFile != NULL;
+
+	// algorithms which only know about references through sampling always need it
+	if ( policy->needs_sampling && sampleInterval <= 0 ) sampleInterval = 1000;
+
+	// by default sample a quarter of the frames per tick
+	if ( sampleBatch <= 0 ) sampleBatch = nframes/4 > 0 ? nframes/4 : 1;
+
 	
-	is_frame_occup_struc = malloc(nframes * sizeof(int)); // allocate memory for structure storing frame occupation info
+	free_frames = frame_pool_create(nframes); // create the pool of free frames, initially no frame is occupied
 
-	if(is_frame_occup_struc == NULL) {
+	if(free_frames == NULL) {
 		printf("Error allocating space for structure storing frame occupation information!\n");
 		exit(1);
 	}
@@ -313,31 +572,24 @@ int main( int argc, char *argv[] )
     // initialize the arrays to store frame status
     for(int i=0; i < nframes; i++)
     {
-       is_frame_occup_struc[i] = 0;  // initially no frame is occupied
        frame_holds_what[i] = 0;  		// initially no frame holds any physical page
     }
 
 
-	// for fifo
-	if ( !strcmp(PRAlgoToUse, "fifo") )
-	{
-		fifo_page_queue = malloc(nframes * sizeof(int));		// allocate memory for fifo queue
-		if(fifo_page_queue == NULL) {
-			printf("Error allocating space for fifo page queue!\n");
-			exit(1);
-		}
-	}
+	// the log of the swap-slot map needs room to move pages around: half as many slots again, at least two segments
+	int nblocks = useSwapMap ? npages + (npages/2 > 32 ? npages/2 : 32) : npages;
 
-	// for LRU, initialize pointers to page list
-	if ( !strcmp(PRAlgoToUse, "custom") )
+	// try to create a disk, read and written past the host's page cache if asked to and the file system allows it
+	if ( directIO )
 	{
-		head = NULL;
-		tail = NULL;
-		currPage = head;
+		disk = disk_open_direct("myvirtualdisk", nblocks);
+		if ( !disk )
+		{
+			fprintf(stderr,"couldn't open virtual disk with O_DIRECT: %s, using the page cache\n",strerror(errno));
+			directIO = 0;
+		}
 	}
-
-	// try to create a disk
-	disk = disk_open("myvirtualdisk", npages);
+	if ( !disk ) disk = disk_open("myvirtualdisk", nblocks);
 	
 	// if 0 is returned then disk is not created. Therefore show error
 	if(!disk) {
@@ -346,13 +598,41 @@ int main( int argc, char *argv[] )
 	}
 
 	// try to cretae page table
-	struct page_table *pt = page_table_create( npages, nframes, page_fault_handler );
+	struct page_table *pt = NULL;
+	if ( userFault )
+	{
+		pt = page_table_create_userfault( npages, nframes, page_fault_handler );
+		if ( !pt )
+		{
+			fprintf(stderr,"couldn't take page faults from a userfaultfd: %s, using signals\n",strerror(errno));
+			userFault = 0;
+		}
+	}
+	if ( !pt ) pt = page_table_create( npages, nframes, page_fault_handler );
 	
 	// if 0 is returned then page table is not created. Therefore show error
 	if(!pt) {
 		fprintf(stderr,"couldn't create page table: %s\n",strerror(errno));
 		return 1;
 	}
+	pagetable = pt;
+
+	// set up the page replacement algorithm
+	if ( policy->init(&live_host, npages, nframes) < 0 )
+	{
+		printf("Error allocating space for the %s page replacement algorithm!\n", policy->name);
+		exit(1);
+	}
+
+	// open the trace last, so it only holds the references of the program
+	if ( traceFile )
+	{
+		trace = trace_create(traceFile, npages, traceMmap);
+		if(!trace) {
+			fprintf(stderr,"couldn't create trace file %s: %s\n",traceFile,strerror(errno));
+			return 1;
+		}
+	}
 
 	// get pointer to virtual memory from the page table
 	virtmem = page_table_get_virtmem(pt);
@@ -360,22 +640,139 @@ int main( int argc, char *argv[] )
 	// get pointer to physical memory from the page table
 	physmem = page_table_get_physmem(pt);
 
+	// start collecting referenced bits without any help from the programs
+	if ( sampleInterval > 0 )
+	{
+		page_table_set_sampling(pt, sampleInterval, sampleBatch);
+	}
 
-	// run appropriate program base on the command given by the user.
-	if(!strcmp(program,"sort")) {
-		sort_program(virtmem,npages*PAGE_SIZE);
 
-	} else if(!strcmp(program,"scan")) {
-		scan_program(virtmem,npages*PAGE_SIZE);
+	// read-ahead never takes more than half of the memory, so the pages it guesses do not crowd out the ones in use
+	if ( readAheadMax > nframes/2 ) readAheadMax = nframes/2;
+	if ( readAheadMax > 0 )
+	{
+		readAheadWindow = readAheadMax < 4 ? readAheadMax : 4;
 
-	} else if(!strcmp(program,"focus")) {
-		focus_program(virtmem,npages*PAGE_SIZE);
+		prefetched = calloc(npages, 1);
+		if(prefetched == NULL) {
+			printf("Error allocating space for the read-ahead state of the pages!\n");
+			exit(1);
+		}
+	}
+
+	// every thread has at least a page of its own
+	if ( nThreads > npages ) nThreads = npages;
+	if ( nThreads < 1 ) nThreads = 1;
+	frameReading = calloc(nframes, 1);
+	if(frameReading == NULL) {
+		printf("Error allocating space for the frames being read!\n");
+		exit(1);
+	}
+
+	// a fault reads its own page and at most readAheadMax more, and every thread may have a fault waiting with its reads not started
+	pageIns = malloc((readAheadMax+1) * nThreads * sizeof(struct disk_io));
+	if(pageIns == NULL) {
+		printf("Error allocating space for the pages being read in!\n");
+		exit(1);
+	}
+
+	// read-ahead only fills free frames: on a full memory, a fault frees enough of them for a whole batch
+	if ( readAheadMax > 0 && reclaimHigh == 0 ) reclaimHigh = readAheadMax + 1;
+
+	// a fault reclaims at most half of the memory, or it would evict pages still in use
+	if ( reclaimHigh > nframes/2 ) reclaimHigh = nframes/2;
+	int maxEvicting = reclaimHigh > 1 ? reclaimHigh : 1;
+	frameReclaiming = calloc(nframes, 1);
+	evictPages = malloc(maxEvicting * sizeof(int));
+	evictFrames = malloc(maxEvicting * sizeof(int));
+	evictWrites = malloc(maxEvicting * sizeof(struct disk_io));
+	if(frameReclaiming == NULL || evictPages == NULL || evictFrames == NULL || evictWrites == NULL) {
+		printf("Error allocating space for the pages being evicted!\n");
+		exit(1);
+	}
+
+	// no page has been written yet, whatever the disk file holds
+	if ( zeroFill )
+	{
+		pageBacked = calloc((npages+7)/8, 1);
+		if(pageBacked == NULL) {
+			printf("Error allocating space for the bitmap of pages on disk!\n");
+			exit(1);
+		}
+	}
+
+	// every page starts out in its own block, unless it starts out zeroed
+	if ( useSwapMap )
+	{
+		swapMap = swap_map_create(npages, nblocks);
+		if(swapMap == NULL) {
+			printf("Error allocating space for the swap-slot map!\n");
+			exit(1);
+		}
+
+		for(int i=0; zeroFill && i < npages; i++) swap_map_release(swapMap, i);
+	}
+
+	// evicted pages go to the compressed tier first
+	if ( tierBudget > 0 )
+	{
+		tier = ztier_create(tierBudget, npages, PAGE_SIZE, tier_spill);
+		if(tier == NULL) {
+			printf("Error allocating space for the compressed tier!\n");
+			exit(1);
+		}
+	}
+
+	// without io_uring the queues still work, their transfers are only done synchronously
+	if ( useQueue )
+	{
+		faultQueue = disk_queue_create(disk, readAheadMax+1, physmem, (long) nframes*PAGE_SIZE);
+		if ( flushClean > 0 ) flushQueue = disk_queue_create(disk, FLUSH_BATCH, physmem, (long) nframes*PAGE_SIZE);
+
+		if ( faultQueue == NULL || (flushClean > 0 && flushQueue == NULL) )
+		{
+			printf("Error allocating space for the disk queues!\n");
+			exit(1);
+		}
+	}
+
+	// start writing back dirty pages in the background
+	if ( flushClean > 0 )
+	{
+		if ( flushClean > nframes ) flushClean = nframes;
+
+		frameWriteback = calloc(nframes, 1);
+		if(frameWriteback == NULL) {
+			printf("Error allocating space for the write-back state of the frames!\n");
+			exit(1);
+		}
+
+		if ( pthread_create(&flusher, NULL, flusher_thread, pt) != 0 )
+		{
+			fprintf(stderr,"couldn't start the flusher: %s\n",strerror(errno));
+			return 1;
+		}
+	}
+
+
+	// run appropriate program base on the command given by the user, timing it to see how the fault handler scales with -threads
+	struct timespec runStart, runEnd;
+	clock_gettime(CLOCK_MONOTONIC, &runStart);
+	if ( nThreads > 1 ) run_threads(program, virtmem, npages);
+	else run_program(program, virtmem, npages*PAGE_SIZE);
+	clock_gettime(CLOCK_MONOTONIC, &runEnd);
+	double runSeconds = (runEnd.tv_sec - runStart.tv_sec) + (runEnd.tv_nsec - runStart.tv_nsec) / 1e9;
 
-	} else {
-		fprintf(stderr,"unknown program: %s\n",argv[3]);
 
+	// stop the flusher before looking at the results
+	if ( flushClean > 0 )
+	{
+		flusherStop = 1;
+		pthread_join(flusher, NULL);
 	}
 
+	// stop sampling so the page table does not change while it is printed
+	page_table_set_sampling(pt, 0, 0);
 
 	//printing final state of the page table
 	printf("--------------------------------------------------------------\n");
@@ -388,11 +785,62 @@ int main( int argc, char *argv[] )
 	printf("Disk Reads: %d\n", diskReads);
 	printf("Disk Writes: %d\n", diskWrites);
 	printf("Page Faults: %d\n", pageFaults);
+	printf("Write Faults Avoided: %d\n", writeFaultsAvoided);
+	if ( sampleInterval > 0 ) printf("Sampled Re-faults: %d\n", page_table_get_soft_faults(pt));
+	if ( flushClean > 0 ) printf("Flusher Writes: %d\n", flusherWrites);
+	if ( readAheadMax > 0 ) printf("Read-ahead Pages: %d Hits: %d Wasted: %d\n", readAheadPages, readAheadHits, readAheadWaste);
+	if ( directIO ) printf("Disk Mode: O_DIRECT\n");
+	if ( userFault ) printf("Fault Mode: userfaultfd\n");
+	if ( nThreads > 1 ) printf("Threads: %d Raced Faults: %d Frame Waits: %d\n", nThreads, page_table_get_raced_faults(pt), frameWaits);
+	if ( reclaimHigh > 0 ) printf("Reclaim Batches: %d Frames: %d (%.1f each) Unmap Calls: %d\n", reclaimBatches, reclaimFrames,
+		reclaimBatches > 0 ? (double) reclaimFrames / reclaimBatches : 0, unmapCalls);
+	if ( tier )
+	{
+		struct ztier_stats zs;
+		ztier_get_stats(tier, &zs);
+		printf("Compressed Tier Hits: %ld Misses: %ld Hit Ratio: %.1f%%\n", zs.hits, zs.misses,
+			zs.hits + zs.misses > 0 ? 100.0 * zs.hits / (zs.hits + zs.misses) : 0);
+		printf("Compressed Tier Stores: %ld Rejected: %ld Spills: %ld Spill Writes: %d\n", zs.stores, zs.rejected, zs.spills, tierSpillWrites);
+		printf("Compression Ratio: %.2f Bytes Saved: %ld\n", zs.bytes_out > 0 ? (double) zs.bytes_in / zs.bytes_out : 0, zs.bytes_in - zs.bytes_out);
+	}
+	if ( swapMap )
+	{
+		struct swap_map_stats ss;
+		swap_map_get_stats(swapMap, &ss);
+		printf("Swap Slot Writes: %ld Runs: %ld (%.1f pages each) Segments: %ld Reused: %ld Live Slots: %d\n", ss.writes, ss.runs,
+			ss.runs > 0 ? (double) ss.writes / ss.runs : 0, ss.segments, ss.reused, ss.live);
+	}
+	if ( zeroFill ) printf("Zero-fill Reads Avoided: %d Writes Avoided: %d\n", zeroFillReads, zeroDropWrites);
+	if ( useQueue ) printf("Disk Backend: %s\n", disk_queue_async(faultQueue) ? "io_uring" : "pread (io_uring unavailable)");
+	printf("Run Time: %.3f s (%.0f faults/s)\n", runSeconds, pageFaults / runSeconds);
+	printf("Fault Latency p50: %.1f us p99: %.1f us\n", fault_latency_percentile(0.50), fault_latency_percentile(0.99));
+	if ( policy->print_stats ) policy->print_stats();
+
+	if ( trace )
+	{
+		printf("Trace Records: %ld\n", trace_count(trace));
+		if ( trace_close(trace) < 0 ) fprintf(stderr,"couldn't write trace file %s: %s\n",traceFile,strerror(errno));
+		trace = NULL;
+	}
 
 
 	// free the allocated resources
-	free(is_frame_occup_struc);
+	frame_pool_delete(free_frames);
     free(frame_holds_what);
+	free(frameWriteback);
+	free(prefetched);
+	free(pageIns);
+	free(pageBacked);
+	free(frameReclaiming);
+	free(frameReading);
+	free(evictPages);
+	free(evictFrames);
+	free(evictWrites);
+	if ( tier ) ztier_delete(tier);
+	if ( swapMap ) swap_map_delete(swapMap);
+	if ( faultQueue ) disk_queue_delete(faultQueue);
+	if ( flushQueue ) disk_queue_delete(flushQueue);
+	policy->destroy();
 
 	// clean used resources
 	page_table_delete(pt);
@@ -403,141 +851,989 @@ int main( int argc, char *argv[] )
 
 
 
-/*
-	This function implements random page replacement algorithm when a page fault occurs
-	Algorithm: A random frame is chosen from available frames for replacement and the page that it holds is replaced
-*/
-void random_pra( struct page_table *pt, int page )
+/* This function runs the testing program given by the user. Returns -1 if there is no such program. */
+int run_program( const char *program, char *data, int length )
 {
-	int frame_no_toremove= (int)lrand48()%nframes;		// select a random frame to remove
+	if(!strcmp(program,"sort")) {
+		sort_program(data,length);
 
-	replace_page(pt, page, frame_no_toremove);
-}
+	} else if(!strcmp(program,"scan")) {
+		scan_program(data,length);
 
+	} else if(!strcmp(program,"focus")) {
+		focus_program(data,length);
 
+	} else if(!strcmp(program,"mixed")) {
+		mixed_program(data,length);
 
-/*
-	This function implements first in first out (fifo) page replacement algorithm when a page fault occurs
-	Algorithm: A page which came first is chosen for replacement.
-*/ 
-void fifo_pra( struct page_table *pt, int page )
-{
-	int frame_no_toremove= fifo_page_queue[oldest_page];	// select first frame in the queue to replace
+	} else {
+		fprintf(stderr,"unknown program: %s\n",program);
+		return -1;
+	}
 
-	// NOTE here that page will be replaced only if all frames are full
-	// i.e. pointer to newest page location point actually at oldest page which is to be deleted	
+	return 0;
+}
 
-	// shift oldest_page to next oldest_page so that this page is removed from the queue
-	oldest_page = (oldest_page + 1) % nframes;
-	
-	replace_page(pt, page, frame_no_toremove);
 
-	// add the new page at the back of the queue and shift newest_page pointer so that it again points at the location of oldest page which is to be replaced next time.
-	fifo_page_queue[newest_page] = frame_no_toremove;
-	newest_page = (newest_page + 1) % nframes;		// make it a circular queue
-}
 
+// a thread running the program on its part of the memory
+struct program_thread {
+	pthread_t thread;
+	const char *program;
+	char *data;
+	int length;
+};
 
-/*
-	This function implements Least Recently Used (LRU) page replacement algorithm when a page fault occurs
-	Algorithm: Here Linked List approach is used for implementing LRU. 
-		1. If a new page arrives and if there is space in page table, then a new entry is made for that page at the end of the linked list. 
-		2. If a page which is in linked list is referenced again, thenit is put at the end of the list.
-		3. If a new page is arrived and an old page is to be replaced, then the page at the front of the list is replaced and the new page 				is put at the back of the list.
-*/ 
-void custom_pra( struct page_table *pt, int page )
+static void *program_thread( void *arg )
 {
-	int frame_no_toremove = head->page;			// select first page in the page list (which is least recenly used) for replacement.
+	struct program_thread *t = arg;
 
-	// NOTE here that page will be replaced only if all entries in page table are full
-	
-	// shift oldest_page to next oldest_page so that this page is removed from the queue
-	currPage = head;
-	head = head->nextPage;
-	tail->nextPage = currPage;
-	tail = currPage;
-	currPage->nextPage = NULL;
-	
-	replace_page(pt, page, frame_no_toremove);
-}
+	// with SIGSEGV the thread handles its own faults: their reads go through a queue of its own, as only one thread may use a queue
+	if ( useQueue && !userFault )
+	{
+		threadQueue = disk_queue_create(disk, readAheadMax+1, physmem, (long) nframes*PAGE_SIZE);
+		if(threadQueue == NULL) {
+			printf("Error allocating space for the disk queue of a thread!\n");
+			exit(1);
+		}
+	}
 
+	run_program(t->program, t->data, t->length);
 
+	if ( threadQueue ) disk_queue_delete(threadQueue);
+	return NULL;
+}
 
-/* This function replaces the given page (according to page replacement policy) with the new page */
-void replace_page( struct page_table *pt, int page, int frame_no_toremove )
-{
-	int pageno_to_remove= frame_holds_what[frame_no_toremove]; // what page does the frame hold?
 
-	// get page table entry of that page
-	int frame_toremove; 
-	int frame_toremove_bits;
 
-	page_table_get_entry(pt, pageno_to_remove, &frame_toremove, &frame_toremove_bits ); // info from page table 
+/*
+	This function runs the testing program in nThreads threads at once, each on its own npages/nThreads pages,
+	so the threads fault at the same time and the page fault handler runs for several of them at once.
+	The pages left over by the division are not used.
+*/
+void run_threads( const char *program, char *data, int npages )
+{
+	struct program_thread *threads = malloc(nThreads * sizeof(struct program_thread));
+	int slice = npages/nThreads;
 
+	if(threads == NULL) {
+		printf("Error allocating space for the threads of the program!\n");
+		exit(1);
+	}
 
-	// if dirty i.e if it has write access, then have to write this page back in disk and then replace the page
-	if ( (frame_toremove_bits&PROT_WRITE)!=0 )
+	for(int i=0; i < nThreads; i++)
 	{
-		disk_write( disk,pageno_to_remove, &physmem[(frame_toremove)*PAGE_SIZE] ); // write back page to disk
-		diskWrites++;	
+		threads[i].program = program;
+		threads[i].data = data + (long) i*slice*PAGE_SIZE;
+		threads[i].length = slice*PAGE_SIZE;
+
+		if ( pthread_create(&threads[i].thread, NULL, program_thread, &threads[i]) != 0 )
+		{
+			fprintf(stderr,"couldn't start thread %d of the program: %s\n",i,strerror(errno));
+			exit(1);
+		}
 	}
 
-	page_table_set_entry( pt, pageno_to_remove, 0, 0); // 0's invalidate frame entry of previous page
+	for(int i=0; i < nThreads; i++) pthread_join(threads[i].thread, NULL);
 
-	page_table_set_entry( pt, page, (frame_toremove), 0|PROT_READ ); // set new page table entry with read permission
+	free(threads);
+}
 
-	disk_read( disk, page, &physmem[(frame_toremove)*PAGE_SIZE] ); // Read data from disk at virtual address given by 'page' to physical memory frame
-	diskReads++;
 
 
-	// Store info that this page is held in which age frame.
-	// this frame holds this page, inverse of page table.
-	frame_holds_what[(frame_toremove)] = page; // the frame now contains this page.
+/* This function appends a reference to the recorded page-reference string */
+static void record_reference( int page, int write )
+{
+	if (opt_nrefs == opt_refs_size)
+	{
+		opt_refs_size = opt_refs_size ? 2*opt_refs_size : 4096;
+		opt_refs = realloc(opt_refs, opt_refs_size * sizeof(int));
+		if(opt_refs == NULL) {
+			printf("Error allocating space for the page-reference string!\n");
+			exit(1);
+		}
+	}
+
+	opt_refs[opt_nrefs++] = OPT_REF(page, write);
 }
 
 
 
 /*
-	This function tries to find a free frame from the available frames
-
-	INPUT: Structure storing the occupation information of all frames, total frames
-	OUTPUT: Position of free frame if a free frame is found. Otherwise -1.
+	This function is the page fault handler used while recording the page-reference string for OPT
+	Every page has its own frame, so nothing is ever replaced. Only the RECORD_WINDOW pages referenced last are
+	accessible: touching any other page faults, which records a reference to it and takes access away from the
+	oldest of them. One access may span two pages, e.g. a copy from one to the other, and could never complete if
+	each of the two took access away from the other. References among the pages of the window are not recorded,
+	so the curve is exact for memories of RECORD_WINDOW frames or more. OPT only replays the references recorded:
+	its faults are still a lower bound for every other algorithm, but may be fewer than OPT would have on every
+	reference of the program, so they are no longer the exact optimum.
+	A write to the page referenced last faults once more and marks its reference as a write, unless the write
+	is the first access to it. A write to an older page of the window is one more reference to it.
 */
-int findnset_free_frame(int *is_frame_occup_struc, int nframes)
+void record_fault_handler( struct page_table *pt, int page, int write )
 {
-    int i;
-    
-	for (i=0;i<nframes;i++)
+	int i;
+
+	for(i=0; i < RECORD_WINDOW && recordWindow[i] != page; i++);
+
+	if (i == 0)
 	{
-		if (is_frame_occup_struc[i] == 0) 	// if a free frame is found
-		{
-			is_frame_occup_struc[i] = 1; // mark that frame as occupied for the new incoming page 
-			return i;					// return the position of frame
-		}
+		// the page is readable, so this is a write
+		page_table_set_entry(pt, page, page, PROT_READ|PROT_WRITE);
+		opt_refs[recordWindowRef[0]] |= OPT_WRITE;
+		return;
 	}
 
-	// if no free frame is found, the whole page table is full, return -1
-	return -1;
-}
+	if (i == RECORD_WINDOW)
+	{
+		// take access away from the oldest page of the window, its frame keeps the data
+		i = RECORD_WINDOW-1;
+		if (recordWindow[i] >= 0) page_table_set_entry(pt, recordWindow[i], recordWindow[i], 0);
 
+		if (!recordLoaded[page])
+		{
+			disk_read(disk, page, &physmem[page*PAGE_SIZE]);
+			recordLoaded[page] = 1;
+		}
+	}
 
+	page_table_set_entry(pt, page, page, write ? PROT_READ|PROT_WRITE : PROT_READ);
+	record_reference(page, write);
 
-/*****************************************************************************************************************************/
-/*****************************************************************************************************************************/
-/************************* Code implementing testing programs for above functional code **************************************/
+	for(; i > 0; i--)
+	{
+		recordWindow[i] = recordWindow[i-1];
+		recordWindowRef[i] = recordWindowRef[i-1];
+	}
+	recordWindow[0] = page;
+	recordWindowRef[0] = opt_nrefs-1;
+}
 
 
 
-/* This function compares bytes and returns which one is greater 
+/*
+	This function runs the program once to record its page-reference string and then either computes
+	the faults of Belady's optimal algorithm on nframes frames, a lower bound for every other algorithm,
+	or prints the miss-ratio curve of LRU for every memory of 1 to nframes frames.
 */
-static int compare_bytes( const void *pa, const void *pb )
+int run_offline( int npages, int nframes, const char *program )
 {
-	int a = *(char*)pa;
-	int b = *(char*)pb;
+	int faults, reads, writes;
 
-	if(a<b) {
-		return -1;
-	} else if(a==b) {
+	disk = disk_open("myvirtualdisk", npages);
+	if(!disk) {
+		fprintf(stderr,"couldn't create virtual disk: %s\n",strerror(errno));
+		return 1;
+	}
+
+	// as many frames as pages, so the recording itself never replaces a page
+	struct page_table *pt = page_table_create( npages, npages, record_fault_handler );
+	if(!pt) {
+		fprintf(stderr,"couldn't create page table: %s\n",strerror(errno));
+		return 1;
+	}
+
+	virtmem = page_table_get_virtmem(pt);
+	physmem = page_table_get_physmem(pt);
+
+	for(int i=0; i < RECORD_WINDOW; i++) recordWindow[i] = -1;
+
+	recordLoaded = calloc(npages, 1);
+	if(recordLoaded == NULL) {
+		printf("Error allocating space for the pages loaded while recording!\n");
+		exit(1);
+	}
+
+	if (run_program(program, virtmem, npages*PAGE_SIZE) < 0) return 1;
+
+	free(recordLoaded);
+	recordLoaded = NULL;
+
+	if ( !strcmp(PRAlgoToUse, "mrc") )
+	{
+		start_curve(npages, nframes);
+		for(int i=0; i < opt_nrefs; i++) curve_reference(OPT_PAGE(opt_refs[i]));
+		print_curve(nframes);
+	}
+	else
+	{
+		if (opt_simulate(opt_refs, opt_nrefs, npages, nframes, &faults, &reads, &writes) < 0)
+		{
+			printf("Error allocating space for the OPT simulation!\n");
+			exit(1);
+		}
+
+		printf("OPT replay of %d recorded references\n", opt_nrefs);
+		printf("Disk Reads: %d\n", reads);
+		printf("Disk Writes: %d\n", writes);
+		printf("Page Faults: %d\n", faults);
+	}
+
+	free(opt_refs);
+	page_table_delete(pt);
+	disk_close(disk);
+
+	return 0;
+}
+
+
+
+/*
+	This function replays a trace recorded with -trace through the page replacement algorithm on nframes frames,
+	simulating the page table and disk in memory. The number of pages comes from the trace.
+	With sampling, the interval given by -sample counts references instead of microseconds.
+*/
+int run_replay( int nframes, const char *filename )
+{
+	int faults, reads, writes, result;
+	int event, page, write;
+	int lastPage = -1;		// page of the last reference collected for OPT, repeats of it are folded into it
+	long nrefs = 0;
+
+	struct trace_reader *r = trace_open(filename);
+	if(!r) {
+		fprintf(stderr,"couldn't open trace file %s: %s\n",filename,strerror(errno));
+		return 1;
+	}
+
+	// the miss-ratio curve is built while the trace streams by, nothing is kept per reference
+	if ( !strcmp(PRAlgoToUse, "mrc") )
+	{
+		start_curve(trace_npages(r), nframes);
+		while ( (result = trace_next(r, &event, &page, &write)) > 0 ) curve_reference(page);
+		trace_reader_close(r);
+
+		if ( result < 0 )
+		{
+			fprintf(stderr,"trace file %s is corrupt\n",filename);
+			return 1;
+		}
+
+		print_curve(nframes);
+		return 0;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if ( !strcmp(PRAlgoToUse, "opt") )
+	{
+		// collect the reference string, repeats of the same page folded into one reference as while recording it
+		while ( (result = trace_next(r, &event, &page, &write)) > 0 )
+		{
+			nrefs++;
+			if ( page == lastPage )
+			{
+				if ( write ) opt_refs[opt_nrefs-1] |= OPT_WRITE;
+				continue;
+			}
+			record_reference(page, write);
+			lastPage = page;
+		}
+		if ( result < 0 ) result = -2;		// corrupt trace, as replay_simulate reports it
+		else result = opt_simulate(opt_refs, opt_nrefs, trace_npages(r), nframes, &faults, &reads, &writes);
+		free(opt_refs);
+	}
+	else
+	{
+		policy = policy_find(PRAlgoToUse);
+		if ( policy == NULL )
+		{
+			printf("%s", usage);
+			return 1;
+		}
+
+		if ( policy->needs_sampling && sampleInterval <= 0 ) sampleInterval = 1000;
+		if ( sampleBatch <= 0 ) sampleBatch = nframes/4 > 0 ? nframes/4 : 1;
+
+		result = replay_simulate(r, policy, nframes, sampleInterval, sampleBatch, &nrefs, &faults, &reads, &writes);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	trace_reader_close(r);
+
+	if ( result == -2 )
+	{
+		fprintf(stderr,"trace file %s is corrupt\n",filename);
+		return 1;
+	}
+	if ( result < 0 )
+	{
+		printf("Error allocating space for the replay!\n");
+		exit(1);
+	}
+
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("Replay of %ld references in %.3f s (%.1f M references/s)\n", nrefs, seconds, nrefs / seconds / 1e6);
+
+	printf("Disk Reads: %d\n", reads);
+	printf("Disk Writes: %d\n", writes);
+	printf("Page Faults: %d\n", faults);
+	if ( policy && policy->print_stats ) policy->print_stats();
+	if ( policy ) policy->destroy();
+
+	return 0;
+}
+
+
+
+/*
+	This function sets up the miss-ratio curve of LRU for memories of 1 to maxframes frames over npages pages.
+	Without -shards or -shardsmax it is exact, which takes about 20 bytes per page. With them only a sample
+	of the pages is tracked: at a fixed rate, or lowering the rate to track at most -shardsmax pages.
+*/
+void start_curve( int npages, int maxframes )
+{
+	if ( shardsRate > 0 || shardsMax > 0 )
+	{
+		sampledCurve = shards_create(shardsRate > 0 ? shardsRate : 1, shardsMax, maxframes);
+	}
+	else
+	{
+		lruCurve = mrc_create(npages);
+	}
+
+	if(lruCurve == NULL && sampledCurve == NULL) {
+		printf("Error allocating space for the miss-ratio curve!\n");
+		exit(1);
+	}
+}
+
+
+
+/* This function adds a reference to the miss-ratio curve */
+void curve_reference( int page )
+{
+	if ( lruCurve ) mrc_reference(lruCurve, page);
+	else shards_reference(sampledCurve, page);
+}
+
+
+
+/*
+	This function prints the faults of LRU on every memory of 1 to maxframes frames as CSV and frees the curve.
+	An estimated curve has one more column: a heuristic size of the error of its miss ratio, which is no bound on it.
+*/
+void print_curve( int maxframes )
+{
+	double *misses = malloc(maxframes * sizeof(double));
+	double *error = malloc(maxframes * sizeof(double));
+	long *exact = malloc(maxframes * sizeof(long));
+
+	if(misses == NULL || error == NULL || exact == NULL) {
+		printf("Error allocating space for the miss-ratio curve!\n");
+		exit(1);
+	}
+
+	if ( lruCurve )
+	{
+		long nrefs = mrc_nrefs(lruCurve);
+
+		mrc_curve(lruCurve, exact, maxframes);
+
+		printf("nframes,faults,miss_ratio\n");
+		for(int c=1; c <= maxframes; c++)
+		{
+			printf("%d,%ld,%.6f\n", c, exact[c-1], nrefs ? (double) exact[c-1] / nrefs : 0.0);
+		}
+
+		mrc_delete(lruCurve);
+		lruCurve = NULL;
+	}
+	else
+	{
+		long nrefs = shards_nrefs(sampledCurve);
+
+		shards_curve(sampledCurve, misses, error, maxframes);
+
+		// the sample is described on stderr, so stdout stays plain CSV
+		fprintf(stderr, "SHARDS: sampled %ld of %ld references, %d pages tracked at rate %.6f\n",
+			shards_sampled(sampledCurve), nrefs, shards_tracked(sampledCurve), shards_rate(sampledCurve));
+
+		printf("nframes,faults,miss_ratio,heuristic_error\n");
+		for(int c=1; c <= maxframes; c++)
+		{
+			printf("%d,%.0f,%.6f,%.6f\n", c, misses[c-1], nrefs ? misses[c-1] / nrefs : 0.0, error[c-1]);
+		}
+
+		shards_delete(sampledCurve);
+		sampledCurve = NULL;
+	}
+
+	free(misses);
+	free(error);
+	free(exact);
+}
+
+
+
+/* This function evicts the page held by a frame and returns the frame to the pool of free frames */
+void evict_frame( struct page_table *pt, int frame )
+{
+	detach_frame(pt, frame);
+	finish_evictions(pt);
+}
+
+
+
+/*
+	This function starts evicting the page held by a frame: the page is given to the tier or queued to be written back,
+	and the page replacement algorithm forgets it. The page stays mapped and the frame taken until finish_evictions.
+*/
+void detach_frame( struct page_table *pt, int frame )
+{
+	int pageno_to_remove= frame_holds_what[frame]; // what page does the frame hold?
+
+	// get page table entry of that page
+	int frame_toremove; 
+	int frame_toremove_bits;
+
+	// the flusher is writing the page out, or another thread is reading it in: the frame must not be reused before it is done
+	if ( (frameWriteback && frameWriteback[frame]) || frameReading[frame] )
+	{
+		frameWaits++;
+		while ( (frameWriteback && frameWriteback[frame]) || frameReading[frame] )
+		{
+			page_table_unlock(pt);
+			sched_yield();
+			page_table_lock(pt);
+		}
+	}
+
+	// the page is still being read in by this fault: finish reading before the frame is reused
+	for(int i=0; i < nPageIns; i++)
+	{
+		if ( pageIns[i].data == &physmem[frame*PAGE_SIZE] ) finish_page_ins(pt);
+	}
+
+	page_table_get_entry(pt, pageno_to_remove, &frame_toremove, &frame_toremove_bits ); // info from page table 
+
+	// another thread evicted the page while this one waited, or is evicting it: there is nothing left to do here
+	if ( frame_holds_what[frame] != pageno_to_remove || frame_toremove != frame || !frame_toremove_bits || frameReclaiming[frame] ) return;
+
+	// the other threads must not write to the page once its frame is read below, until it is unmapped
+	if ( nThreads > 1 ) page_table_hold(pt, pageno_to_remove);
+
+	// the frame is read below: with userfaultfd, what the program wrote is still in its own copy of the page
+	page_table_sync_frame(pt, frame_toremove);
+
+
+	int dirty = (frame_toremove_bits&PROT_WRITE)!=0;
+
+	// keep the page compressed in memory, unless it is a zero-filled page which is free to bring back anyway
+	if ( tier && !(zeroFill && !PAGE_BACKED(pageno_to_remove) && (!dirty || frame_is_zero(frame_toremove))) )
+	{
+		if ( ztier_store(tier, pageno_to_remove, &physmem[frame_toremove*PAGE_SIZE], dirty) )
+		{
+			if ( dirty ) dirtyFrames--;
+			dirty = 0;		// written to disk when it is spilled from the tier, if ever
+		}
+	}
+
+	// if dirty i.e if it has write access, then have to write this page back in disk before the frame is reused
+	if ( dirty )
+	{
+		if ( zeroFill && frame_is_zero(frame_toremove) )
+		{
+			// nothing but zeros: the next fault on the page zero-fills it again, no need to keep it on disk
+			SET_PAGE_BACKED(pageno_to_remove, 0);
+			if ( swapMap ) swap_map_release(swapMap, pageno_to_remove);
+			zeroDropWrites++;
+		}
+		else
+		{
+			// write back page to disk, together with the other pages evicted by this fault
+			evictWrites[nEvictWrites].block = write_block(pageno_to_remove);
+			evictWrites[nEvictWrites].data = &physmem[(frame_toremove)*PAGE_SIZE];
+			nEvictWrites++;
+			diskWrites++;
+			if ( zeroFill ) SET_PAGE_BACKED(pageno_to_remove, 1);
+		}
+		dirtyFrames--;
+	}
+
+	evictPages[nEvicting] = pageno_to_remove;
+	evictFrames[nEvicting] = frame;
+	nEvicting++;
+	frameReclaiming[frame] = 1;
+
+	// the page was read ahead for nothing: read less ahead from now on
+	if ( prefetched && prefetched[pageno_to_remove] )
+	{
+		prefetched[pageno_to_remove] = 0;
+		readAheadWaste++;
+		if ( readAheadWindow > 1 ) readAheadWindow /= 2;
+	}
+
+	if ( policy->on_evict ) policy->on_evict(pageno_to_remove, frame);
+}
+
+
+
+/*
+	This function finishes the evictions started by detach_frame: the dirty pages are written back sorted by block,
+	so neighbouring blocks go in one system call, the pages are unmapped with one mprotect for every run of neighbouring
+	pages, and the frames go back to the pool of free frames.
+*/
+void finish_evictions( struct page_table *pt )
+{
+	if ( nEvictWrites > 0 && nThreads > 1 )
+	{
+		// the pages are held and their frames are being reclaimed, nothing touches them: the other threads run on meanwhile.
+		// No other fault evicts before missPage is cleared, so the lists stay this fault's
+		page_table_unlock(pt);
+		disk_write_list(disk, evictWrites, nEvictWrites);
+		page_table_lock(pt);
+	}
+	else if ( nEvictWrites > 0 )
+	{
+		disk_write_list(disk, evictWrites, nEvictWrites);
+	}
+
+	unmapCalls += page_table_clear_entries(pt, evictPages, nEvicting);
+
+	for(int i=0; i < nEvicting; i++)
+	{
+		frame_pool_free(free_frames, evictFrames[i]);
+		frameReclaiming[evictFrames[i]] = 0;
+		if ( nThreads > 1 ) page_table_release(pt, evictPages[i]);
+	}
+
+	nEvicting = 0;
+	nEvictWrites = 0;
+}
+
+
+
+/*
+	This function returns a free frame for "page", evicting a page if there is none, or a batch of pages with -reclaim.
+	A fault which evicts may let go of the lock while it waits for a frame, and the page replacement algorithm must
+	not see another miss before its page is inserted: until then it is the only fault which evicts, and the others
+	which find no free frame wait for it.
+*/
+int get_frame( struct page_table *pt, int page )
+{
+	int frame = frame_pool_alloc(free_frames);
+
+	while ( frame == -1 )
+	{
+		if ( missPage != -1 && missPage != page )
+		{
+			page_table_unlock(pt);
+			sched_yield();
+			page_table_lock(pt);
+		}
+		else
+		{
+			missPage = page;
+			if ( reclaimHigh > 0 ) reclaim_frames(pt, page);
+			else evict_frame(pt, policy->choose_victim(page));
+		}
+
+		// the evicted frame is now free, unless another thread took it while this one waited
+		frame = frame_pool_alloc(free_frames);
+	}
+
+	return frame;
+}
+
+
+
+/*
+	This function is called by a fault on "page" which finds no free frame when -reclaim is on. Instead of one page,
+	it evicts pages until reclaimHigh frames are free, so the next faults find a free frame without evicting anything.
+	The page replacement algorithm picks every victim in turn, with the pages already picked looking recently used to it.
+	It stops early if the algorithm picks a frame again, which the random one can do.
+*/
+void reclaim_frames( struct page_table *pt, int page )
+{
+	int target = reclaimHigh - frame_pool_nfree(free_frames);
+
+	for(int i=0; i < target; i++)
+	{
+		int frame = policy->choose_victim(page);
+		if ( frameReclaiming[frame] ) break;
+		detach_frame(pt, frame);
+	}
+
+	reclaimBatches++;
+	reclaimFrames += nEvicting;
+	finish_evictions(pt);
+}
+
+
+
+/*
+	This function reads ahead after a fault which brought "page" in.
+	Two faults in a row at the same distance start a stream with that stride. The next pages of the stream are read
+	into free frames and mapped read-only, so the program finds them in memory. The batch stops at the first page
+	without a free frame: nothing is evicted for a guess. With -reclaim, the frames freed by a reclaim are filled.
+	The pages of a batch are read from disk together with the page faulted on.
+	When the program faults on the page after the last one read ahead, the pages before it have been used:
+	the window doubles up to readAheadMax. A page evicted before it was used halves the window.
+*/
+void read_ahead( struct page_table *pt, int page )
+{
+	int npages = page_table_get_npages(pt);
+	int delta = page - lastFaultPage;
+	int k;
+
+	if ( streamStride != 0 && page == streamNext )
+	{
+		// the stream went on past the last batch: its pages were used. With several threads another fault may have
+		// changed the stride since the batch was read, so the pages are checked to be in memory
+		for(k=0; k < batchCount; k++)
+		{
+			int q = batchStart + k*streamStride;
+			if ( q >= 0 && q < npages && prefetched[q] )
+			{
+				prefetched[q] = 0;
+				readAheadHits++;
+			}
+		}
+
+		readAheadWindow = 2*readAheadWindow < readAheadMax ? 2*readAheadWindow : readAheadMax;
+	}
+	else
+	{
+		// a new stream needs two faults at the same distance
+		streamStride = (delta != 0 && delta == lastFaultDelta) ? delta : 0;
+	}
+
+	lastFaultDelta = delta;
+	lastFaultPage = page;
+	batchCount = 0;
+
+	if ( streamStride == 0 ) return;
+
+	batchStart = page + streamStride;
+
+	for(k=1; k <= readAheadWindow; k++)
+	{
+		int q = page + k*streamStride;
+		int frame, bits;
+
+		if ( q < 0 || q >= npages ) break;		// the stream runs out of memory
+		batchCount = k;
+
+		page_table_get_entry(pt, q, &frame, &bits);
+		if ( bits || page_table_is_held(pt, q) ) continue;		// already in memory, or another thread is bringing it in
+
+		// only free frames are read into: evicting for a guess could cost a write, or even evict the page just faulted on
+		frame = frame_pool_alloc(free_frames);
+		if ( frame == -1 )
+		{
+			batchCount = k-1;
+			break;
+		}
+
+		if ( nThreads > 1 ) page_table_hold(pt, q);
+
+		page_table_set_entry(pt, q, frame, PROT_READ);
+		page_in(q, frame);
+
+		// a page read from disk stays held until finish_page_ins
+		if ( nThreads > 1 ) page_table_release(pt, q);
+
+		frame_holds_what[frame] = q;
+		policy->on_insert(q, frame);
+
+		prefetched[q] = 1;
+		readAheadPages++;
+	}
+
+	streamNext = page + (batchCount+1)*streamStride;
+}
+
+
+
+/*
+	This function starts reading "page" into "frame". Every page read in by a fault is read by finish_page_ins:
+	all of them in flight at once through the fault's disk queue, or otherwise every run of consecutive blocks with one call.
+*/
+void page_in( int page, int frame )
+{
+	int dirty;
+
+	// evicted not long ago: decompress it from the tier, a page the disk has an old copy of stays dirty
+	if ( tier && ztier_load(tier, page, &physmem[frame*PAGE_SIZE], &dirty) )
+	{
+		if ( dirty )
+		{
+			page_table_set_entry(pagetable, page, frame, PROT_READ|PROT_WRITE);
+			dirtyFrames++;
+		}
+		return;
+	}
+
+	// never written: its contents are zeros, not whatever the disk block holds
+	if ( zeroFill && !PAGE_BACKED(page) )
+	{
+		memset(&physmem[frame*PAGE_SIZE], 0, PAGE_SIZE);
+		zeroFillReads++;
+		return;
+	}
+
+	pageIns[nPageIns].block = page_block(page);
+	pageIns[nPageIns].data = &physmem[frame*PAGE_SIZE];
+	nPageIns++;
+	diskReads++;
+
+	// no other thread may see the page before finish_page_ins is done with it
+	if ( nThreads > 1 ) page_table_hold(pagetable, page);
+
+	if ( fault_queue() ) disk_queue_read(fault_queue(), page_block(page), &physmem[frame*PAGE_SIZE], page);
+}
+
+
+
+/*
+	This function returns the disk block holding the contents of "page".
+*/
+int page_block( int page )
+{
+	return swapMap ? swap_map_slot(swapMap, page) : page;
+}
+
+
+
+/*
+	This function returns the disk block the next copy of "page" is written to: the next slot of the log
+	of the swap-slot map, or the page's own block without one.
+*/
+int write_block( int page )
+{
+	return swapMap ? swap_map_assign(swapMap, page) : page;
+}
+
+
+
+/*
+	This function writes a page spilled from the compressed tier to disk, if it is dirty.
+*/
+void tier_spill( int page, const char *data, int dirty )
+{
+	if ( !dirty ) return;
+
+	disk_write(disk, write_block(page), data);
+	diskWrites++;
+	tierSpillWrites++;
+	if ( zeroFill ) SET_PAGE_BACKED(page, 1);
+}
+
+
+
+/*
+	This function returns 1 if the page held by "frame" is all zeros, 0 otherwise.
+*/
+int frame_is_zero( int frame )
+{
+	const long *p = (const long *) &physmem[frame*PAGE_SIZE];
+
+	for(int i=0; i < PAGE_SIZE/sizeof(long); i++)
+	{
+		if ( p[i] != 0 ) return 0;
+	}
+
+	return 1;
+}
+
+
+
+/*
+	This function returns the disk queue of the faults handled by the calling thread, null if there is none.
+	With SIGSEGV and several threads every thread handles its own faults, each has a queue of its own.
+	With userfaultfd one thread handles them all, through the queue of the page fault handler.
+*/
+struct disk_queue * fault_queue()
+{
+	return threadQueue ? threadQueue : faultQueue;
+}
+
+
+
+/*
+	This function waits until every page started by page_in is in memory.
+	With several threads the pages are read without the lock of the page table, also through a disk queue, so the
+	other threads fault meanwhile: the pages stay held and their frames are marked as being read, so that no thread
+	sees a page or reuses its frame before the page is in. The pages are then released.
+*/
+void finish_page_ins( struct page_table *pt )
+{
+	long tags[64];
+	int n = nPageIns;
+	struct disk_queue *q = fault_queue();
+	struct disk_io reads[n > 0 ? n : 1];
+
+	// faults handled while the lock is let go start reads of their own
+	memcpy(reads, pageIns, n * sizeof(struct disk_io));
+	nPageIns = 0;
+
+	if ( n > 0 && nThreads > 1 )
+	{
+		for(int i=0; i < n; i++) frameReading[(reads[i].data - physmem)/PAGE_SIZE] = 1;
+
+		page_table_unlock(pt);
+		if ( q ) while ( disk_queue_pending(q) > 0 ) disk_queue_wait(q, tags, 64, 1);
+		else disk_read_list(disk, reads, n);
+		page_table_lock(pt);
+
+		for(int i=0; i < n; i++) frameReading[(reads[i].data - physmem)/PAGE_SIZE] = 0;
+	}
+	else if ( q )
+	{
+		while ( disk_queue_pending(q) > 0 ) disk_queue_wait(q, tags, 64, 1);
+	}
+	else if ( n > 0 )
+	{
+		disk_read_list(disk, reads, n);
+	}
+
+	// the frames were given their pages before the reads were finished
+	for(int i=0; nThreads > 1 && i < n; i++) page_table_release(pt, frame_holds_what[(reads[i].data - physmem)/PAGE_SIZE]);
+}
+
+
+
+/*
+	This function is the write-back flusher, run in a thread of its own while the program runs.
+	Whenever fewer than flushClean frames are clean, it takes the next dirty frames in round robin order, up to FLUSH_BATCH
+	of them, write-protects their pages so that a new write to one faults and makes it dirty again, and writes them
+	to disk together without holding the lock of the page table: all in flight at once through its disk queue,
+	or otherwise every run of consecutive blocks with one call. Evicting a clean page needs no write, so most faults only read.
+*/
+void *flusher_thread( void *arg )
+{
+	struct page_table *pt = arg;
+	int cursor = 0;		// next frame to look at
+	struct disk_io batch[FLUSH_BATCH];
+	int frames[FLUSH_BATCH];
+	long tags[FLUSH_BATCH];
+	int pages[FLUSH_BATCH];
+	sigset_t all;
+
+	// faults and sampling ticks belong to the program's thread
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+	while ( !flusherStop )
+	{
+		int n = 0;
+
+		page_table_lock(pt);
+
+		for(int i=0; i < nframes && n < FLUSH_BATCH && dirtyFrames > nframes - flushClean; i++)
+		{
+			int f, bits;
+			int page = frame_holds_what[cursor];
+
+			page_table_get_entry(pt, page, &f, &bits);
+
+			if ( f == cursor && (bits & PROT_WRITE) && !frameWriteback[cursor] && !frameReclaiming[cursor] )
+			{
+				page_table_set_entry(pt, page, cursor, PROT_READ);
+				dirtyFrames--;
+
+				if ( zeroFill && frame_is_zero(cursor) )
+				{
+					// nothing but zeros: clean without a write, the next fault after an eviction zero-fills it again
+					SET_PAGE_BACKED(page, 0);
+					if ( swapMap ) swap_map_release(swapMap, page);
+					zeroDropWrites++;
+				}
+				else
+				{
+					// consecutive slots of the log for the pages of a batch, when there is a swap-slot map
+					frameWriteback[cursor] = 1;
+					frames[n] = cursor;
+					pages[n] = page;
+					batch[n].block = write_block(page);
+					batch[n].data = &physmem[cursor*PAGE_SIZE];
+					n++;
+				}
+			}
+
+			cursor = (cursor + 1) % nframes;
+		}
+
+		page_table_unlock(pt);
+
+		if ( n == 0 )
+		{
+			// nothing to clean, look again a bit later
+			struct timespec pause = { 0, 100000 };
+			nanosleep(&pause, NULL);
+			continue;
+		}
+
+		// the pages are write-protected, but a write fault may make one writable again while it is written, so the
+		// block on disk can be torn. The fault marks the page dirty again: it is written anew before its frame is
+		// reused, and its frame waits for this write first (see detach_frame)
+		if ( flushQueue )
+		{
+			for(int i=0; i < n; i++) disk_queue_write(flushQueue, batch[i].block, batch[i].data, i);
+			while ( disk_queue_pending(flushQueue) > 0 ) disk_queue_wait(flushQueue, tags, FLUSH_BATCH, 1);
+		}
+		else
+		{
+			disk_write_list(disk, batch, n);
+		}
+
+		page_table_lock(pt);
+		for(int i=0; i < n; i++)
+		{
+			frameWriteback[frames[i]] = 0;
+			if ( zeroFill ) SET_PAGE_BACKED(pages[i], 1);
+		}
+		flusherWrites += n;
+		diskWrites += n;
+		page_table_unlock(pt);
+	}
+
+	return NULL;
+}
+
+
+
+/* This function returns the time within which the fraction p of the page faults were handled, in microseconds */
+double fault_latency_percentile( double p )
+{
+	long total = 0, seen = 0;
+	int i;
+
+	for(i=0; i < LATENCY_BUCKETS; i++) total += faultLatency[i];
+
+	for(i=0; i < LATENCY_BUCKETS; i++)
+	{
+		seen += faultLatency[i];
+		if ( seen > 0 && seen >= p * total ) break;
+	}
+
+	if ( i == LATENCY_BUCKETS ) return 0;
+
+	// middle of the bucket
+	return (i + 0.5) * LATENCY_BUCKET_NS / 1000.0;
+}
+
+
+
+/*****************************************************************************************************************************/
+/*****************************************************************************************************************************/
+/************************* Code implementing testing programs for above functional code **************************************/
+
+
+
+/* This function compares bytes and returns which one is greater 
+*/
+static int compare_bytes( const void *pa, const void *pb )
+{
+	int a = *(char*)pa;
+	int b = *(char*)pb;
+
+	if(a<b) {
+		return -1;
+	} else if(a==b) {
 		return 0;
 	} else {
 		return 1;
@@ -547,41 +1843,63 @@ static int compare_bytes( const void *pa, const void *pb )
 
 
 
+/*
+	These functions give the random numbers of the programs: the same sequence rand() gives after srand(), but every thread
+	has its own, so each thread of a run with -threads does the same as the program alone on its part of the memory.
+*/
+static __thread struct random_data programRandom;
+static __thread char programRandomState[128];
+
+static void program_srand( unsigned seed )
+{
+	memset(&programRandom, 0, sizeof(programRandom));
+	initstate_r(seed, programRandomState, sizeof(programRandomState), &programRandom);
+}
+
+static int program_rand()
+{
+	int32_t r;
+	random_r(&programRandom, &r);
+	return r;
+}
+
+
+
 /* Standard program having random data access */
 void focus_program( char *data, int length )
 {
 	int total=0;
 	int i,j;
 
-	srand(3829);
+	program_srand(3829);
 
 	for(i=0;i<length;i++) {
 		data[i] = 0;		// write access to memory
 
-		// if LRU we need to re-arrange page list if the page is in the list
-		if ( !strcmp(PRAlgoToUse, "custom") )
+		// if the algorithm uses access information, tell it about this access
+		if ( trackAccesses )
 		{
 //			printf("page accessed: %d\n", i/PAGE_SIZE);	
 	
-			rearrange_page_list(i);
+			page_accessed(i, 1);
 		}
 
 	}
 
 	for(j=0;j<1000;j++) {
-		int start = rand()%length;
+		int start = program_rand()%length;
 		int size = 25;
 
 		for(i=0;i<1000;i++) {
-			int index = length-1-(start+rand()%(i+j+2))%length;
-			data[ index ] = rand();								// write access to memory
+			int index = length-1-(start+program_rand()%(i+j+2))%length;
+			data[ index ] = program_rand();								// write access to memory
 				
-			// if LRU we need to re-arrange page list if the page is in the list
-			if ( !strcmp(PRAlgoToUse, "custom") )
+			// if the algorithm uses access information, tell it about this access
+			if ( trackAccesses )
 			{
 //				printf("page accessed: %d\n", index/PAGE_SIZE);
 
-				rearrange_page_list(index);
+				page_accessed(index, 1);
 			}
 		}
 	}
@@ -589,12 +1907,12 @@ void focus_program( char *data, int length )
 	for(i=0;i<length;i++) {
 		total += data[i];			// read access to memory
 
-		// if LRU we need to re-arrange page list if the page is in the list
-		if ( !strcmp(PRAlgoToUse, "custom") )
+		// if the algorithm uses access information, tell it about this access
+		if ( trackAccesses )
 		{
 //			printf("page accessed: %d\n", i/PAGE_SIZE);
 			
-			rearrange_page_list(i);
+			page_accessed(i, 0);
 		}
 	}
 
@@ -609,10 +1927,10 @@ void sort_program( char *data, int length )
 	int total = 0;
 	int i;
 
-	srand(4856);
+	program_srand(4856);
 
 	for(i=0;i<length;i++) {
-		data[i] = rand();
+		data[i] = program_rand();
 		printf("page accessed: %d\n", i/PAGE_SIZE);
 	}
 
@@ -639,11 +1957,11 @@ void scan_program( char *cdata, int length )
 //	for(i=0;i<length;i++) {
 		data[i] = i%256;
 
-		if ( !strcmp(PRAlgoToUse, "custom") )
+		if ( trackAccesses )
 		{
 			printf("page accessed: %d\n", i/PAGE_SIZE);
 	
-			rearrange_page_list(i);
+			page_accessed(i, 1);
 		}
 
 	}
@@ -652,11 +1970,11 @@ void scan_program( char *cdata, int length )
 		for(i=0;i<length;i+=PAGE_SIZE) {
 //		for(i=0;i<length;i++) {
 			total += data[i];
-			if ( !strcmp(PRAlgoToUse, "custom") )
+			if ( trackAccesses )
 			{
 				printf("page accessed: %d\n", i/PAGE_SIZE);
 				
-				rearrange_page_list(i);
+				page_accessed(i, 0);
 			}
 		}
 	}
@@ -666,47 +1984,69 @@ void scan_program( char *cdata, int length )
 
 
 
-/* This function re-arranges the page list by removing existing page from the list and putting it at the tail of the list.
-	This is a requirement for LRU page Replacement algorithm 
-*/
-void rearrange_page_list(int i)
+/* Program alternating between a small hot set and one time sequential sweeps over all of the memory */
+void mixed_program( char *cdata, int length )
 {
-	int page_accessed = i/PAGE_SIZE;
+	unsigned i, j, k;
+	unsigned char *data = (unsigned char *) cdata;
+	unsigned total = 0;
+	int hot = length/8;		// the hot set is the first eighth of the memory
+	int page;
 
-	//check if page in list. If page not found then there is already a fault which will be handled
-	// if page found the put it at tail i.e. most recently used
+	program_srand(5261);
 
-	prevPage = NULL;
-	currPage = head;
+	if(hot < PAGE_SIZE) hot = PAGE_SIZE;
 
-	while ( currPage != NULL )
-	{
-	
-		if (currPage->page == page_accessed)
-		{
-			// remove page and put and tail
-		
-			if (currPage != tail)
-			{
-				if(currPage != head)
-				{
-					prevPage->nextPage = currPage->nextPage;				
-					currPage->nextPage = tail->nextPage;
-					tail->nextPage = currPage;
-					tail = currPage;
-				}
-				else
-				{
-					head = head->nextPage;
-					tail->nextPage = currPage;
-					currPage->nextPage = NULL;
-				}
-			}
+	for(j=0;j<10;j++) {
+		// focus phase: random writes to the hot set
+		for(k=0;k<2000;k++) {
+			int index = program_rand()%hot;
+			data[index] = program_rand();
 
-			break;
+			if ( trackAccesses ) page_accessed(index, 1);
 		}
 
-		prevPage = currPage;
-		currPage = currPage->nextPage;
+		// scan phase: read every page once
+		for(page=0;page<length/PAGE_SIZE;page++) {
+			i = page*PAGE_SIZE;
+			total += data[i];
+
+			if ( trackAccesses ) page_accessed(i, 0);
+		}
 	}
+
+//	printf("mixed result is %d\n",total);
+}
+
+
+
+/*
+	This function is called by the programs after every access, if the page replacement algorithm or the trace uses access information
+	"write" is 1 if the access wrote to memory and 0 if it only read
+*/
+void page_accessed(int i, int write)
+{
+	int page = i/PAGE_SIZE;
+
+	// the other threads fault and report their accesses at the same time
+	if ( nThreads > 1 ) page_table_lock(pagetable);
+
+	// several accesses in a row to the same page are a single reference to it
+	if ( page == lastAccessedPage )
+	{
+		// except that the trace keeps the first write after reads
+		if ( trace && write && !lastAccessWrite ) trace_record(trace, TRACE_ACCESS, page, 1);
+		lastAccessWrite |= write;
+	}
+	else
+	{
+		lastAccessedPage = page;
+		lastAccessWrite = write;
+
+		if ( trace ) trace_record(trace, TRACE_ACCESS, page, write);
+
+		if ( policy->on_access ) policy->on_access(page);
+	}
+
+	if ( nThreads > 1 ) page_table_unlock(pagetable);
 }
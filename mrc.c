@@ -0,0 +1,163 @@
+#include "mrc.h"
+
+#include <stdlib.h>
+
+
+
+// structure holding the stack distance histogram and what is needed to compute distances
+struct mrc {
+	int npages;		// no of pages referenced
+	long nrefs;		// no of references seen
+	long cold;		// no of first references to a page, misses in every memory
+	long *hist;		// hist[d] is the no of references at stack distance d, 1 <= d <= npages
+	int *last;		// time of the last reference to every page, 0 if never referenced
+	int *at;		// at[t] is the page referenced at time t, valid if last[at[t]] == t
+	int *tree;		// Fenwick tree over times 1 .. size: 1 at the last reference time of every page
+	int size;		// no of times the tree can hold before it is compacted
+	int now;		// time of the next reference
+};
+
+
+
+/* Add "v" at time "t" of the tree. */
+static void tree_add( struct mrc *m, int t, int v )
+{
+	for(; t<=m->size; t += t & -t) m->tree[t] += v;
+}
+
+
+
+/* Return the no of pages whose last reference is at a time <= t. */
+static int tree_sum( struct mrc *m, int t )
+{
+	int s = 0;
+
+	for(; t>0; t -= t & -t) s += m->tree[t];
+
+	return s;
+}
+
+
+
+/*
+Renumber the last reference times of all pages as 1, 2, 3 .. keeping their order, and rebuild the tree.
+At most npages times are live and the tree holds twice as many, so this is done at most once every npages references.
+*/
+static void compact( struct mrc *m )
+{
+	int t, k = 0;
+
+	for(t=1;t<m->now;t++) {
+		int page = m->at[t];
+		if(page>=0 && m->last[page]==t) {
+			k++;
+			m->last[page] = k;
+			m->at[k] = page;
+		}
+	}
+
+	// every live time holds a 1: build the tree in linear time
+	for(t=1;t<=m->size;t++) m->tree[t] = 0;
+	for(t=1;t<=m->size;t++) {
+		if(t<=k) m->tree[t] += 1;
+		int parent = t + (t & -t);
+		if(parent<=m->size) m->tree[parent] += m->tree[t];
+	}
+
+	m->now = k+1;
+}
+
+
+
+/*
+Create an empty curve for references to the pages 0 .. npages-1.
+Returns a pointer to the new curve, or null on failure.
+*/
+struct mrc * mrc_create( int npages )
+{
+	int i;
+	struct mrc *m = calloc(1, sizeof(*m));
+	if(!m) return 0;
+
+	m->npages = npages;
+	m->size = 2*npages > 64 ? 2*npages : 64;
+	m->now = 1;
+
+	m->hist = calloc(npages+1, sizeof(long));
+	m->last = calloc(npages, sizeof(int));
+	m->at = malloc((m->size+1) * sizeof(int));
+	m->tree = calloc(m->size+1, sizeof(int));
+
+	if(!m->hist || !m->last || !m->at || !m->tree) {
+		mrc_delete(m);
+		return 0;
+	}
+
+	for(i=0;i<=m->size;i++) m->at[i] = -1;
+
+	return m;
+}
+
+
+
+/* Delete a curve and free its memory. */
+void mrc_delete( struct mrc *m )
+{
+	free(m->hist);
+	free(m->last);
+	free(m->at);
+	free(m->tree);
+	free(m);
+}
+
+
+
+/* Add a reference to "page" to the curve. */
+void mrc_reference( struct mrc *m, int page )
+{
+	if(m->now > m->size) compact(m);
+
+	int prev = m->last[page];
+
+	if(prev) {
+		// distinct pages referenced after the last reference to this page, plus the page itself
+		int distance = tree_sum(m, m->now-1) - tree_sum(m, prev) + 1;
+		m->hist[distance]++;
+		tree_add(m, prev, -1);
+	} else {
+		m->cold++;
+	}
+
+	tree_add(m, m->now, 1);
+	m->last[page] = m->now;
+	m->at[m->now] = page;
+	m->now++;
+	m->nrefs++;
+}
+
+
+
+/* Return the number of references added to the curve. */
+long mrc_nrefs( struct mrc *m )
+{
+	return m->nrefs;
+}
+
+
+
+/*
+Fill misses[c-1] with the number of misses of LRU on a memory of c frames, for every c from 1 to "maxframes".
+*/
+void mrc_curve( struct mrc *m, long *misses, int maxframes )
+{
+	int c;
+	long beyond = m->cold;		// misses of a memory of npages frames
+
+	for(c=m->npages+1;c<=maxframes;c++) misses[c-1] = m->cold;
+
+	// a memory of c frames misses every reference at a distance above c
+	for(c=m->npages;c>=1;c--) {
+		if(c<=maxframes) misses[c-1] = beyond;
+		beyond += m->hist[c];
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef MRC_H
+#define MRC_H
+
+
+
+/*
+A one pass miss-ratio curve of LRU, built from the stack distances of Mattson et al.
+LRU is a stack algorithm: a memory of c frames holds exactly the c most recently used pages, so a reference
+hits in every memory bigger than its stack distance (the number of distinct pages used since the last reference
+to the same page, itself included) and misses in every smaller one. One histogram of stack distances therefore
+gives the misses of LRU for every memory size at once.
+Distances are counted with a Fenwick tree over the time of the last reference to every page, which
+costs O(log npages) per reference.
+*/
+struct mrc;
+
+
+
+/*
+Create an empty curve for references to the pages 0 .. npages-1.
+Returns a pointer to the new curve, or null on failure.
+*/
+struct mrc * mrc_create( int npages );
+
+
+
+/* Delete a curve and free its memory. */
+void mrc_delete( struct mrc *m );
+
+
+
+/* Add a reference to "page" to the curve. */
+void mrc_reference( struct mrc *m, int page );
+
+
+
+/* Return the number of references added to the curve. */
+long mrc_nrefs( struct mrc *m );
+
+
+
+/*
+Fill misses[c-1] with the number of misses of LRU on a memory of c frames, for every c from 1 to "maxframes".
+The misses of a memory include the first reference to every page.
+*/
+void mrc_curve( struct mrc *m, long *misses, int maxframes );
+
+
+
+#endif
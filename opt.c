@@ -0,0 +1,136 @@
+#include "opt.h"
+
+#include <stdlib.h>
+#include <limits.h>
+
+
+
+// an entry in the max-heap of resident pages, ordered by the time of their next use
+struct opt_entry {
+	int next_use;		// index of the next reference to the page, INT_MAX if never used again
+	int page;
+};
+
+
+
+/* Push an entry onto the max-heap. */
+static void heap_push( struct opt_entry *heap, int *size, int next_use, int page )
+{
+	int i = (*size)++;
+
+	// sift up
+	while(i>0 && heap[(i-1)/2].next_use < next_use) {
+		heap[i] = heap[(i-1)/2];
+		i = (i-1)/2;
+	}
+
+	heap[i].next_use = next_use;
+	heap[i].page = page;
+}
+
+
+
+/* Remove and return the entry with the furthest next use. */
+static struct opt_entry heap_pop( struct opt_entry *heap, int *size )
+{
+	struct opt_entry top = heap[0];
+	struct opt_entry last = heap[--(*size)];
+	int i = 0;
+
+	// sift the last entry down from the root
+	while(2*i+1 < *size) {
+		int child = 2*i+1;
+		if(child+1 < *size && heap[child+1].next_use > heap[child].next_use) child++;
+		if(heap[child].next_use <= last.next_use) break;
+		heap[i] = heap[child];
+		i = child;
+	}
+
+	if(*size>0) heap[i] = last;
+
+	return top;
+}
+
+
+
+/*
+Replay the reference string "refs" of length "nrefs" over "npages" pages on a memory of "nframes" frames,
+always evicting the page used furthest in the future.
+Returns 0 on success, -1 if memory for the simulation cannot be allocated.
+*/
+int opt_simulate( const int *refs, int nrefs, int npages, int nframes, int *faults, int *reads, int *writes )
+{
+	int i;
+	int nresident = 0;
+	int heap_size = 0;
+
+	int *next = malloc(sizeof(int)*(nrefs>0 ? nrefs : 1));		// next[i]: index of the next reference to the page of refs[i]
+	int *last_seen = malloc(sizeof(int)*npages);			// scratch: first later reference to every page
+	int *next_use = malloc(sizeof(int)*npages);			// next use of every resident page, -1 if not resident
+	char *dirty = calloc(npages, 1);				// 1 if the resident page has been written
+	struct opt_entry *heap = malloc(sizeof(struct opt_entry)*(nrefs+1));	// one entry per reference at most, stale ones are skipped
+
+	if(!next || !last_seen || !next_use || !dirty || !heap) {
+		free(next); free(last_seen); free(next_use); free(dirty); free(heap);
+		return -1;
+	}
+
+	*faults = *reads = *writes = 0;
+
+	// walk the string backwards to find the next use of every reference
+	for(i=0;i<npages;i++) last_seen[i] = INT_MAX;
+	for(i=nrefs-1;i>=0;i--) {
+		int page = OPT_PAGE(refs[i]);
+		next[i] = last_seen[page];
+		last_seen[page] = i;
+	}
+
+	for(i=0;i<npages;i++) next_use[i] = -1;
+
+	for(i=0;i<nrefs;i++) {
+		int page = OPT_PAGE(refs[i]);
+		int write = refs[i] & OPT_WRITE;
+
+		if(next_use[page] < 0) {
+			// page fault: bring the page in, evicting the page used furthest in the future if memory is full
+			(*faults)++;
+
+			if(nresident == nframes) {
+				struct opt_entry victim;
+
+				// entries whose page has been used again since they were pushed are stale
+				do {
+					victim = heap_pop(heap, &heap_size);
+				} while(next_use[victim.page] != victim.next_use);
+
+				if(dirty[victim.page]) (*writes)++;
+				dirty[victim.page] = 0;
+				next_use[victim.page] = -1;
+				nresident--;
+			}
+
+			(*reads)++;
+			nresident++;
+
+			// a write maps the page writable on the same fault
+			if(refs[i] & OPT_WRITE_FIRST) dirty[page] = 1;
+		}
+
+		// writing a clean page is one more fault, as it only had read permission
+		if(write && !dirty[page]) {
+			(*faults)++;
+			dirty[page] = 1;
+		}
+
+		next_use[page] = next[i];
+		heap_push(heap, &heap_size, next[i], page);
+	}
+
+	free(next);
+	free(last_seen);
+	free(next_use);
+	free(dirty);
+	free(heap);
+
+	return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef OPT_H
+#define OPT_H
+
+
+
+/*
+Belady's optimal (OPT / MIN) page replacement, simulated offline over a recorded page-reference string.
+It evicts the resident page whose next use lies furthest in the future, which gives the lowest possible
+number of page faults for a given number of frames.
+*/
+
+
+
+/*
+Encode a reference to "page" in the reference string, "write" is 1 if the access making the reference is a write
+and 0 if it is a read. A reference is also marked OPT_WRITE when the page is written later while it is the
+page referenced last.
+*/
+#define OPT_WRITE 1			// the page is written during the reference
+#define OPT_WRITE_FIRST 2		// the access making the reference is a write
+#define OPT_REF(page,write) (((page) << 2) | ((write) ? OPT_WRITE|OPT_WRITE_FIRST : 0))
+#define OPT_PAGE(ref) ((ref) >> 2)
+
+
+
+/*
+Replay the reference string "refs" of length "nrefs" over "npages" pages on a memory of "nframes" frames,
+always evicting the page used furthest in the future.
+Faults, disk reads and disk writes are counted the way the page fault handler in main.c counts them:
+a fault brings a page in read-only, or writable if the access faulting is a write, a write to a read-only
+page is one more fault that makes it dirty, and evicting a dirty page writes it back.
+Returns 0 on success, -1 if memory for the simulation cannot be allocated.
+*/
+int opt_simulate( const int *refs, int nrefs, int npages, int nframes, int *faults, int *reads, int *writes );
+
+
+
+#endif
@@ -9,12 +9,24 @@
 
 
 
-
+/*
+The page table of the virtual memory the program runs in. The physical memory is a file mapped into the process,
+and a page is mapped onto its frame of that file with mmap(MAP_FIXED) and the protection of its entry.
+An access the entry does not allow is a fault, passed to the page fault handler. Faults are taken from SIGSEGV,
+or from a userfaultfd by a thread of the page table.
+The page table can also sample references for the aging policy, and hold pages while their frames are filled or
+read, so that the other threads of a multi-threaded program wait for them.
+*/
 struct page_table;
 
 
 
-typedef void (*page_fault_handler_t) ( struct page_table *pt, int page );
+/*
+A page fault handler is called with the page faulted on, and "write" 1 if the access was a write, 0 if it was a read
+or the machine does not tell: then a write to a page mapped read-only faults once more.
+It may let go of the lock of the page table while it waits for the disk, see page_table_hold.
+*/
+typedef void (*page_fault_handler_t) ( struct page_table *pt, int page, int write );
 
 
 
@@ -25,6 +37,18 @@ struct page_table * page_table_create( int npages, int nframes, page_fault_handl
 
 
 
+/*
+Create a new page table like page_table_create, but take its faults from a userfaultfd instead of SIGSEGV.
+A thread of the page table reads the faults and calls "handler" for them, while the program waits.
+The program's pages are copies of their frames: a page mapped by page_table_set_entry is copied in with
+UFFDIO_COPY when it is accessed, write-protected with UFFDIO_WRITEPROTECT while it is mapped read-only,
+and copied back to its frame when it loses write access. See page_table_sync_frame.
+Returns 0 if userfaultfd with write-protect faults is not available, e.g. on kernels before 5.7.
+*/
+struct page_table * page_table_create_userfault( int npages, int nframes, page_fault_handler_t handler );
+
+
+
 /* Delete a page table and the corresponding virtual and physical memories. */
 void page_table_delete( struct page_table *pt );
 
@@ -38,6 +62,42 @@ void page_table_set_entry( struct page_table *pt, int page, int frame, int bits
 
 
 
+/*
+Take away every access to the "n" pages in "pages", as page_table_set_entry(pt,page,0,0) does for each,
+but with one system call for every run of consecutive pages. "pages" is sorted in place.
+Returns the number of system calls made.
+*/
+int page_table_clear_entries( struct page_table *pt, int *pages, int n );
+
+
+
+/*
+Make a frame hold what the program wrote to the page mapped to it.
+It must be called before reading a frame whose page is still mapped writable. With signals the frame is
+the page itself and this does nothing.
+*/
+void page_table_sync_frame( struct page_table *pt, int frame );
+
+
+
+/*
+Keep a page without access while a thread of the program fills its frame, or reads it to evict the page, so that
+no other thread sees the page half done or writes to it behind the reader's back.
+The page's entry may be set meanwhile; the page gets the access of its entry when it has been released as many
+times as it was held. A fault on a held page waits until it is released and retries the access, without calling
+the handler, and a fault on a page which has the access it needs by then is only counted as raced.
+The sampler leaves held pages alone.
+*/
+void page_table_hold( struct page_table *pt, int page );
+void page_table_release( struct page_table *pt, int page );
+
+
+
+/* Return 1 if a page is held, 0 otherwise. */
+int page_table_is_held( struct page_table *pt, int page );
+
+
+
 /*
 Get the frame number and access bits associated with a page.
 "frame" and "bits" must be pointers to integers which will be filled with the current values.
@@ -75,4 +135,57 @@ void page_table_print_entry( struct page_table *pt, int page );
 /* Print out the state of every page in a page table. */
 void page_table_print( struct page_table *pt );
 
+
+
+/*
+Start reference sampling: every "interval_us" microseconds of cpu time the next "batch" resident frames are aged
+and access to their pages is revoked. The next access to such a page re-faults; the fault is handled here,
+without calling the page fault handler, and only sets the page's referenced bit.
+A shorter interval or a bigger batch gives more accurate recency at the cost of more re-faults.
+An interval or batch of 0 stops sampling.
+*/
+void page_table_set_sampling( struct page_table *pt, int interval_us, int batch );
+
+
+
+/* Run one sampling tick by hand. This is what the sampling timer does. */
+void page_table_sample( struct page_table *pt );
+
+
+
+/*
+Return the referenced bit of a page and clear it.
+The bit is set when a page is mapped and when it is accessed again after being sampled.
+*/
+int page_table_test_and_clear_ref( struct page_table *pt, int page );
+
+
+
+/*
+Return the aging counter of a page: the referenced bits of the last 8 sampling intervals, the most recent one
+in the highest bit, with the current referenced bit above them. Pages with a smaller value were used less recently.
+*/
+int page_table_get_age( struct page_table *pt, int page );
+
+
+
+/* Return the number of re-faults on sampled pages. */
+int page_table_get_soft_faults( struct page_table *pt );
+
+
+
+/* Return the number of faults on a page another thread had just given access to, which the handler did not see. */
+int page_table_get_raced_faults( struct page_table *pt );
+
+
+
+/*
+Take or release the lock of the page table.
+The page fault handler is always called with the lock held, and the sampler skips a tick while it is held,
+so another thread may only change the page table between page_table_lock and page_table_unlock.
+It is a spin lock, which a signal handler may take.
+*/
+void page_table_lock( struct page_table *pt );
+void page_table_unlock( struct page_table *pt );
+
 #endif
@@ -0,0 +1,437 @@
+/*
+The page replacement policies selectable from the command line.
+Each policy keeps its own state and only talks to the memory through its struct policy_host.
+*/
+
+#include "policy.h"
+#include "lru.h"
+#include "arc.h"
+#include "twoq.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+// the host of the policy in use, and the size of the memory it manages
+static const struct policy_host *host = NULL;
+static int npages = 0;
+static int nframes = 0;
+
+
+
+/* Remember the host and memory size, common to every policy. */
+static void policy_setup( const struct policy_host *h, int np, int nf )
+{
+	host = h;
+	npages = np;
+	nframes = nf;
+}
+
+
+
+/* Hooks for policies which have nothing to do. */
+static void nothing( void )
+{
+}
+
+static void no_insert( int page, int frame )
+{
+}
+
+
+
+/*************************************** rand ***************************************/
+/*
+	Random page replacement
+	Algorithm: A random frame is chosen from available frames for replacement and the page that it holds is replaced
+*/
+
+static int rand_init( const struct policy_host *h, int np, int nf )
+{
+	policy_setup(h, np, nf);
+	return 0;
+}
+
+static int rand_victim( int page )
+{
+	return (int)lrand48()%nframes;		// select a random frame to remove
+}
+
+
+
+/*************************************** fifo ***************************************/
+/*
+	First in first out (fifo) page replacement
+	Algorithm: A page which came first is chosen for replacement.
+	The frames are kept in a circular queue in the order their pages were brought in.
+*/
+
+static int oldest_page = 0;
+static int newest_page = 0;
+static int *fifo_page_queue = NULL;
+
+static int fifo_init( const struct policy_host *h, int np, int nf )
+{
+	policy_setup(h, np, nf);
+
+	oldest_page = newest_page = 0;
+	fifo_page_queue = malloc(nframes * sizeof(int));		// allocate memory for fifo queue
+	return fifo_page_queue ? 0 : -1;
+}
+
+static void fifo_insert( int page, int frame )
+{
+	// add the new page at the back of the queue
+	fifo_page_queue[newest_page] = frame;
+	newest_page = (newest_page + 1) % nframes;		// make it a circular queue
+}
+
+static int fifo_victim( int page )
+{
+	int frame_no_toremove = fifo_page_queue[oldest_page];	// select first frame in the queue to replace
+
+	// shift oldest_page to next oldest_page so that this page is removed from the queue
+	oldest_page = (oldest_page + 1) % nframes;
+
+	return frame_no_toremove;
+}
+
+static void fifo_destroy( void )
+{
+	free(fifo_page_queue);
+	fifo_page_queue = NULL;
+}
+
+
+
+/*************************************** custom (LRU) ***************************************/
+/*
+	Least Recently Used (LRU) page replacement
+	Algorithm: Here a doubly linked list indexed by page number is used for implementing LRU.
+		1. If a new page arrives, it is put at the end of the list.
+		2. If a page which is in the list is referenced again, then it is moved to the end of the list.
+		3. If an old page is to be replaced, then the page at the front of the list is replaced.
+	Since every page has its own slot in the list, all three steps take constant time.
+*/
+
+static struct lru_list *lru_pages = NULL;
+
+static int lru_init( const struct policy_host *h, int np, int nf )
+{
+	policy_setup(h, np, nf);
+
+	lru_pages = lru_create(npages);
+	return lru_pages ? 0 : -1;
+}
+
+static void lru_on_insert( int page, int frame )
+{
+	lru_insert(lru_pages, page);
+}
+
+static void lru_on_access( int page )
+{
+	// if page is in the list, put it at tail i.e. most recently used
+	// if page is not in the list then there is already a fault which will be handled
+	lru_touch(lru_pages, page);
+}
+
+static int lru_victim( int page )
+{
+	// the first page in the list is the least recently used one
+	return host->page_frame(lru_oldest(lru_pages));
+}
+
+static void lru_on_evict( int page, int frame )
+{
+	lru_remove(lru_pages, page);
+}
+
+static void lru_destroy( void )
+{
+	lru_delete(lru_pages);
+	lru_pages = NULL;
+}
+
+
+
+/*************************************** aging ***************************************/
+/*
+	Approximate LRU (aging) page replacement
+	Algorithm: The page table samples references in the background (see page_table_set_sampling), which gives every page
+		an aging counter made of its referenced bits of the last intervals. The frame whose page has the smallest counter,
+		i.e. which was referenced least recently, is replaced. The programs do not need to report their accesses.
+*/
+
+static int aging_hand = 0;		// start each search where the last one ended, so ties do not always pick the same frame
+
+static int aging_init( const struct policy_host *h, int np, int nf )
+{
+	policy_setup(h, np, nf);
+
+	aging_hand = 0;
+	return 0;
+}
+
+static int aging_victim( int page )
+{
+	int frame_no_toremove = aging_hand;
+	int min_age = -1;
+
+	for (int i = 0; i < nframes; i++)
+	{
+		int frame = (aging_hand + i) % nframes;
+		int age = host->get_age(host->frame_page(frame));
+
+		if (min_age < 0 || age < min_age)
+		{
+			min_age = age;
+			frame_no_toremove = frame;
+		}
+	}
+
+	aging_hand = (frame_no_toremove + 1) % nframes;
+
+	return frame_no_toremove;
+}
+
+
+
+/*************************************** clock and eclock ***************************************/
+/*
+	CLOCK (second chance) page replacement
+	Algorithm: Frames are arranged in a circle with a hand pointing at the next candidate. If the page in that frame has been
+		referenced, it gets a second chance: its referenced bit is cleared and the hand moves on. The first frame found
+		without the referenced bit is replaced.
+	A reference is either an access reported by the programs or a fault / sampled re-fault seen by the page table.
+
+	Enhanced CLOCK (not recently used) page replacement
+	Algorithm: Every frame is put in a class by its (referenced, dirty) bits.
+		The hand goes around looking for the best class:
+		1. look for (0,0) - not used recently and clean, without changing anything.
+		2. look for (0,1) - not used recently but dirty, clearing the referenced bits on the way.
+		3. repeat 1 and 2, now that all referenced bits are cleared.
+	Clean pages are preferred, so fewer pages have to be written back to the disk.
+*/
+
+static unsigned char *clock_ref = NULL;	// referenced bit of every page, set when the programs access it
+static int clock_hand = 0;		// next frame the clock hand looks at
+
+static int clock_init( const struct policy_host *h, int np, int nf )
+{
+	policy_setup(h, np, nf);
+
+	clock_hand = 0;
+	clock_ref = calloc(npages, 1);
+	return clock_ref ? 0 : -1;
+}
+
+static void clock_on_access( int page )
+{
+	clock_ref[page] = 1;
+}
+
+/* Tell whether the page held by a frame has been referenced since the hand last passed it, and clear that. */
+static int clock_test_and_clear_ref( int frame )
+{
+	int page = host->frame_page(frame);
+	int ref = clock_ref[page];
+	clock_ref[page] = 0;
+
+	// always clear the host's bit as well, so an old reference is not seen again next time
+	return host->test_and_clear_ref(page) | ref;
+}
+
+static int clock_victim( int page )
+{
+	// at most one full turn clears all bits, so this always ends
+	while ( clock_test_and_clear_ref(clock_hand) )
+	{
+		clock_hand = (clock_hand + 1) % nframes;
+	}
+
+	int frame_no_toremove = clock_hand;
+	clock_hand = (clock_hand + 1) % nframes;
+
+	return frame_no_toremove;
+}
+
+static int eclock_victim( int page )
+{
+	int frame_no_toremove = -1;
+
+	for (int pass = 0; pass < 4 && frame_no_toremove < 0; pass++)
+	{
+		for (int i = 0; i < nframes; i++)
+		{
+			int frame = (clock_hand + i) % nframes;
+			int resident = host->frame_page(frame);
+			int dirty = host->is_dirty(resident);
+			int ref;
+
+			if (pass % 2 == 0)	// look without clearing
+			{
+				ref = clock_ref[resident] || (host->get_age(resident) >> 8);
+			}
+			else			// look and clear
+			{
+				ref = clock_test_and_clear_ref(frame);
+			}
+
+			if (!ref && dirty == (pass % 2))
+			{
+				frame_no_toremove = frame;
+				break;
+			}
+		}
+	}
+
+	// with all referenced bits cleared, pass 4 always finds a frame
+	clock_hand = (frame_no_toremove + 1) % nframes;
+
+	return frame_no_toremove;
+}
+
+static void clock_on_evict( int page, int frame )
+{
+	clock_ref[page] = 0;
+}
+
+static void clock_destroy( void )
+{
+	free(clock_ref);
+	clock_ref = NULL;
+}
+
+
+
+/*************************************** arc ***************************************/
+/*
+	Adaptive Replacement Cache (ARC) page replacement
+	Algorithm: See arc.h. ARC decides which resident page to evict; the frame holding that page is replaced.
+	Choosing a victim already puts the incoming page in ARC's lists, so it is not inserted a second time.
+	A page in the lists whose fault asks for a victim has had its miss handled already, by this fault, which
+	may have let go of the lock since while it waited for a frame.
+*/
+
+static struct arc *arc_pages = NULL;
+
+static int arc_init( const struct policy_host *h, int np, int nf )
+{
+	policy_setup(h, np, nf);
+
+	arc_pages = arc_create(npages, nframes);
+	return arc_pages ? 0 : -1;
+}
+
+static void arc_insert( int page, int frame )
+{
+	// nothing is evicted while there are free frames
+	if (!arc_resident(arc_pages, page)) arc_miss(arc_pages, page);
+}
+
+static void arc_access( int page )
+{
+	arc_hit(arc_pages, page);
+}
+
+static int arc_victim( int page )
+{
+	// a batch of evictions asks again for the same fault: the miss is already handled
+	if (arc_resident(arc_pages, page)) return host->page_frame(arc_evict(arc_pages, page));
+
+	return host->page_frame(arc_miss(arc_pages, page));
+}
+
+static void arc_stats( void )
+{
+	arc_print_stats(arc_pages);
+}
+
+static void arc_destroy( void )
+{
+	arc_delete(arc_pages);
+	arc_pages = NULL;
+}
+
+
+
+/*************************************** 2q ***************************************/
+/*
+	2Q page replacement
+	Algorithm: See twoq.h. 2Q decides which resident page to evict; the frame holding that page is replaced.
+	Choosing a victim already puts the incoming page in the queues, so it is not inserted a second time,
+	and a page in them whose fault asks for a victim has had its miss handled already, as with ARC.
+*/
+
+static struct twoq *twoq_pages = NULL;
+
+static int twoq_init( const struct policy_host *h, int np, int nf )
+{
+	policy_setup(h, np, nf);
+
+	twoq_pages = twoq_create(npages, nframes);
+	return twoq_pages ? 0 : -1;
+}
+
+static void twoq_insert( int page, int frame )
+{
+	// nothing is evicted while there are free frames
+	if (!twoq_resident(twoq_pages, page)) twoq_miss(twoq_pages, page);
+}
+
+static void twoq_access( int page )
+{
+	twoq_hit(twoq_pages, page);
+}
+
+static int twoq_victim( int page )
+{
+	// a batch of evictions asks again for the same fault: the miss is already handled
+	if (twoq_resident(twoq_pages, page)) return host->page_frame(twoq_evict(twoq_pages, page));
+
+	return host->page_frame(twoq_miss(twoq_pages, page));
+}
+
+static void twoq_stats( void )
+{
+	twoq_print_stats(twoq_pages);
+}
+
+static void twoq_destroy( void )
+{
+	twoq_delete(twoq_pages);
+	twoq_pages = NULL;
+}
+
+
+
+/*************************************** registry ***************************************/
+
+static const struct policy policies[] = {
+	//  name     sampling  init        insert         access           victim         evict         stats       destroy
+	{ "rand",    0, rand_init,  no_insert,     0,               rand_victim,   0,            0,          nothing },
+	{ "fifo",    0, fifo_init,  fifo_insert,   0,               fifo_victim,   0,            0,          fifo_destroy },
+	{ "custom",  0, lru_init,   lru_on_insert, lru_on_access,   lru_victim,    lru_on_evict, 0,          lru_destroy },
+	{ "aging",   1, aging_init, no_insert,     0,               aging_victim,  0,            0,          nothing },
+	{ "clock",   0, clock_init, no_insert,     clock_on_access, clock_victim,  clock_on_evict, 0,        clock_destroy },
+	{ "eclock",  0, clock_init, no_insert,     clock_on_access, eclock_victim, clock_on_evict, 0,        clock_destroy },
+	{ "arc",     0, arc_init,   arc_insert,    arc_access,      arc_victim,    0,            arc_stats,  arc_destroy },
+	{ "2q",      0, twoq_init,  twoq_insert,   twoq_access,     twoq_victim,   0,            twoq_stats, twoq_destroy },
+};
+
+
+
+/* Return the policy with the given name, or null if there is none. */
+const struct policy * policy_find( const char *name )
+{
+	int i;
+
+	for(i=0;i<(int)(sizeof(policies)/sizeof(policies[0]));i++) {
+		if(!strcmp(policies[i].name, name)) return &policies[i];
+	}
+
+	return 0;
+}
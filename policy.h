@@ -0,0 +1,61 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+
+
+/*
+What a page replacement policy may ask about the memory it manages.
+It is provided by whoever drives the policy, so the same policy code works on the live page table and elsewhere.
+*/
+struct policy_host {
+	int (*frame_page)( int frame );			// page held by a frame
+	int (*page_frame)( int page );			// frame holding a resident page
+	int (*is_dirty)( int page );			// 1 if a resident page has been written since it was brought in
+	int (*test_and_clear_ref)( int page );		// referenced bit of a page, see page_table_test_and_clear_ref
+	int (*get_age)( int page );			// aging counter of a page, see page_table_get_age
+};
+
+
+
+/*
+A page replacement policy.
+It is looked up once by name, after that the page fault handler and the programs only call through these pointers.
+The optional hooks may be null.
+*/
+struct policy {
+	const char *name;
+
+	// 1 if the policy only learns about references through reference sampling (see page_table_set_sampling)
+	int needs_sampling;
+
+	// set up the policy for "npages" pages on "nframes" frames. Returns 0 on success, -1 on failure
+	int (*init)( const struct policy_host *host, int npages, int nframes );
+
+	// "page" has been brought into "frame"
+	void (*on_insert)( int page, int frame );
+
+	// optional: a program accessed "page". If null, the programs do not need to report their accesses
+	void (*on_access)( int page );
+
+	// all frames are in use and "page" has to be brought in: return the frame to give up.
+	// With -reclaim it is asked again for the same page, for more frames to free, before the page is inserted
+	int (*choose_victim)( int page );
+
+	// optional: "page" has been evicted from "frame"
+	void (*on_evict)( int page, int frame );
+
+	// optional: print statistics of the policy at the end of the run
+	void (*print_stats)( void );
+
+	// free everything the policy allocated
+	void (*destroy)( void );
+};
+
+
+
+/* Return the policy with the given name, or null if there is none. */
+const struct policy * policy_find( const char *name );
+
+
+
+#endif
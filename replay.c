@@ -0,0 +1,203 @@
+#include "replay.h"
+
+#include <stdlib.h>
+
+
+
+// state of a page of the simulated memory
+#define PAGE_ABSENT	0	// not in memory
+#define PAGE_CLEAN	1	// in memory, read-only
+#define PAGE_DIRTY	2	// in memory, written since it was brought in
+
+
+
+// the simulated page table
+static int npages;
+static int nframes;
+static unsigned char *page_state = NULL;	// PAGE_ABSENT, PAGE_CLEAN or PAGE_DIRTY for every page
+static int *page_frame = NULL;			// frame holding every resident page
+static int *frame_page = NULL;			// page held by every frame, -1 if none
+static unsigned char *page_ref = NULL;		// referenced bit of every page
+static unsigned char *page_age = NULL;		// aging counter of every page
+static int sample_cursor = 0;			// next frame to sample
+
+
+
+/* The policy host of a replay: answers the policy's questions from the simulated page table */
+static int replay_frame_page( int frame )
+{
+	return frame_page[frame];
+}
+
+static int replay_page_frame( int page )
+{
+	return page_frame[page];
+}
+
+static int replay_is_dirty( int page )
+{
+	return page_state[page] == PAGE_DIRTY;
+}
+
+static int replay_test_and_clear_ref( int page )
+{
+	int ref = page_ref[page];
+	page_ref[page] = 0;
+	return ref;
+}
+
+static int replay_get_age( int page )
+{
+	return (page_ref[page] << 8) | page_age[page];
+}
+
+static const struct policy_host replay_host = {
+	replay_frame_page,
+	replay_page_frame,
+	replay_is_dirty,
+	replay_test_and_clear_ref,
+	replay_get_age,
+};
+
+
+
+/* Age the next "batch" frames, the same as page_table_sample */
+static void sample( int batch )
+{
+	int i;
+
+	for(i=0;i<batch;i++) {
+		int page = frame_page[sample_cursor];
+
+		sample_cursor = (sample_cursor + 1) % nframes;
+
+		if(page<0) continue;		// frame holds no page
+
+		page_age[page] = (page_age[page] >> 1) | (page_ref[page] << 7);
+		page_ref[page] = 0;
+	}
+}
+
+
+
+/* Free the simulated page table */
+static void free_tables()
+{
+	free(page_state);
+	free(page_frame);
+	free(frame_page);
+	free(page_ref);
+	free(page_age);
+	page_state = NULL;
+	page_frame = frame_page = NULL;
+	page_ref = page_age = NULL;
+}
+
+
+
+/*
+Drive "policy" with every reference of the trace "r" on a memory of "nframes" frames.
+Returns 0 on success, -1 if memory for the simulation cannot be allocated, -2 if the trace is corrupt.
+The policy is left set up, so the caller can print its statistics before destroying it.
+*/
+int replay_simulate( struct trace_reader *r, const struct policy *policy, int frames, int sample_refs, int sample_batch,
+	long *nrefs, int *faults, int *reads, int *writes )
+{
+	int i, event, page, write, result;
+	int used = 0;			// frames handed out so far, they are filled in order like the free frame pool does
+	int last_page = -1;		// repeated references to the same page are one reference, as in page_accessed
+	int until_sample = sample_refs;
+	long refs = 0;
+
+	npages = trace_npages(r);
+	nframes = frames;
+	sample_cursor = 0;
+	*faults = *reads = *writes = 0;
+
+	page_state = calloc(npages, 1);
+	page_frame = malloc(npages * sizeof(int));
+	frame_page = malloc(nframes * sizeof(int));
+	page_ref = calloc(npages, 1);
+	page_age = calloc(npages, 1);
+
+	if(!page_state || !page_frame || !frame_page || !page_ref || !page_age) {
+		free_tables();
+		return -1;
+	}
+
+	for(i=0;i<nframes;i++) frame_page[i] = -1;
+
+	if(policy->init(&replay_host, npages, nframes) < 0) {
+		free_tables();
+		return -1;
+	}
+
+	// every record, whether the program reported it or it faulted, is a reference to its page
+	while((result = trace_next(r, &event, &page, &write)) > 0) {
+		refs++;
+
+		if(page_state[page] == PAGE_ABSENT) {
+			// the page fault handler: find a frame, evicting a page if memory is full, and read the page in
+			int frame;
+
+			(*faults)++;
+
+			if(used < nframes) {
+				frame = used++;
+			} else {
+				frame = policy->choose_victim(page);
+
+				int old = frame_page[frame];
+				if(page_state[old] == PAGE_DIRTY) (*writes)++;
+				page_state[old] = PAGE_ABSENT;
+				page_ref[old] = page_age[old] = 0;
+				frame_page[frame] = -1;
+
+				if(policy->on_evict) policy->on_evict(old, frame);
+			}
+
+			page_state[page] = PAGE_CLEAN;
+			page_frame[page] = frame;
+			frame_page[frame] = page;
+			page_ref[page] = 1;
+			page_age[page] = 0;
+			(*reads)++;
+
+			policy->on_insert(page, frame);
+			last_page = page;
+
+			// a write maps the page writable on the same fault
+			if(write) page_state[page] = PAGE_DIRTY;
+
+		} else if(write && page_state[page] == PAGE_CLEAN) {
+			// write to a read-only page: faults and the page becomes dirty, still a hit for the policy
+			(*faults)++;
+			page_state[page] = PAGE_DIRTY;
+			page_ref[page] = 1;
+
+			if(page != last_page) {
+				last_page = page;
+				if(policy->on_access) policy->on_access(page);
+			}
+
+		} else {
+			// a hit: with sampling on, the first access after a sample would re-fault and set the referenced bit
+			if(sample_refs > 0) page_ref[page] = 1;
+
+			if(page != last_page) {
+				last_page = page;
+				if(policy->on_access) policy->on_access(page);
+			}
+		}
+
+		if(sample_refs > 0 && --until_sample == 0) {
+			sample(sample_batch);
+			until_sample = sample_refs;
+		}
+	}
+
+	*nrefs = refs;
+	free_tables();
+
+	return result < 0 ? -2 : 0;
+}
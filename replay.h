@@ -0,0 +1,32 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "policy.h"
+#include "trace.h"
+
+
+
+/*
+Replay of a recorded page-reference trace (see trace.h) through a page replacement policy.
+The page table, the frames and the disk are only simulated as arrays, so no signal is taken and no
+protection is changed: a reference costs a few array lookups instead of a SIGSEGV and a couple of system calls.
+*/
+
+
+
+/*
+Drive "policy" with every reference of the trace "r" on a memory of "nframes" frames.
+Faults, disk reads and disk writes are counted the way the page fault handler in main.c counts them:
+a reference to a page not in memory is a fault which reads it in, read-only unless the reference is a write,
+a write to a read-only page is one more fault that makes it dirty, and evicting a dirty page writes it back.
+If "sample_refs" is more than 0, the referenced bits and aging counters are sampled for "sample_batch" frames
+every "sample_refs" references, as page_table_sample does on every tick of the timer in a live run.
+The number of references replayed is stored in "nrefs".
+Returns 0 on success, -1 if memory for the simulation cannot be allocated, -2 if the trace is corrupt.
+*/
+int replay_simulate( struct trace_reader *r, const struct policy *policy, int nframes, int sample_refs, int sample_batch,
+	long *nrefs, int *faults, int *reads, int *writes );
+
+
+
+#endif
@@ -0,0 +1,438 @@
+#include "shards.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+
+
+#define SHARDS_MODULUS	(1<<24)		// hash values of pages are taken modulo this, the threshold is compared against them
+
+
+
+// a sampled page in the table of tracked pages
+struct shards_entry {
+	int page;		// -1 if the slot is empty
+	int last;		// time of the last reference to the page
+};
+
+
+
+// structure holding a sampled estimate
+struct shards {
+	int threshold;			// a page is sampled if its hash is below this
+	int max_pages;			// most pages tracked at once in fixed size mode, 0 in fixed rate mode
+	int maxframes;			// largest memory the curve is needed for
+
+	long nrefs;			// no of references seen
+	long sampled;			// no of references sampled
+	double cold;			// weight of first references to a sampled page
+	double beyond;			// weight of references at a distance over maxframes
+	double *hist;			// hist[d] is the weight of references at an estimated distance of d, 1 <= d <= maxframes
+	double total;			// weight of all sampled references
+
+	struct shards_entry *table;	// open addressing table of the tracked pages, linear probing
+	int capacity;			// no of slots in the table, a power of 2
+	int tracked;			// no of pages in the table
+
+	int *heap;			// fixed size mode: max-heap of the tracked pages by hash value
+	int *at;			// at[t] is the page referenced at sampled time t, valid if its last time is t
+	int *tree;			// Fenwick tree over sampled times 1 .. size: 1 at the last reference time of every tracked page
+	int size;			// no of times the tree can hold before it is compacted
+	int now;			// sampled time of the next sampled reference
+};
+
+
+
+/* Hash a page number to a value in 0 .. SHARDS_MODULUS-1, mixing all of its bits. */
+static int page_hash( int page )
+{
+	unsigned long long x = (unsigned) page;
+
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+
+	return x & (SHARDS_MODULUS-1);
+}
+
+
+
+/* Return the slot holding "page" in the table, or the empty slot where it would go. */
+static int table_find( struct shards *s, int page )
+{
+	int mask = s->capacity - 1;
+	int i = page_hash(page) & mask;
+
+	while(s->table[i].page >= 0 && s->table[i].page != page) i = (i+1) & mask;
+
+	return i;
+}
+
+
+
+/* Remove the page in slot "i" from the table, moving back the entries after it so no lookup misses them. */
+static void table_remove( struct shards *s, int i )
+{
+	int mask = s->capacity - 1;
+	int j = i;
+
+	for(;;) {
+		s->table[i].page = -1;
+
+		// find the next entry which may move into the hole at i
+		for(;;) {
+			j = (j+1) & mask;
+			if(s->table[j].page < 0) return;
+
+			int home = page_hash(s->table[j].page) & mask;
+			// the entry at j can move to i if its home slot is not cyclically in (i, j]
+			if(i <= j ? (home <= i || home > j) : (home <= i && home > j)) break;
+		}
+
+		s->table[i] = s->table[j];
+		i = j;
+	}
+}
+
+
+
+/* Add "v" at time "t" of the tree. */
+static void tree_add( struct shards *s, int t, int v )
+{
+	for(; t<=s->size; t += t & -t) s->tree[t] += v;
+}
+
+
+
+/* Return the no of tracked pages whose last reference is at a time <= t. */
+static int tree_sum( struct shards *s, int t )
+{
+	int sum = 0;
+
+	for(; t>0; t -= t & -t) sum += s->tree[t];
+
+	return sum;
+}
+
+
+
+/*
+Renumber the last reference times of the tracked pages as 1, 2, 3 .. keeping their order, and rebuild the tree,
+which is resized to "size" times. Returns 0 on success, -1 if the tree cannot be resized.
+*/
+static int compact( struct shards *s, int size )
+{
+	int t, k = 0;
+
+	if(size != s->size) {
+		int *at = realloc(s->at, (size+1) * sizeof(int));
+		if(!at) return -1;
+		s->at = at;
+
+		int *tree = realloc(s->tree, (size+1) * sizeof(int));
+		if(!tree) return -1;
+		s->tree = tree;
+	}
+
+	for(t=1;t<s->now;t++) {
+		int page = s->at[t];
+		struct shards_entry *e = &s->table[table_find(s, page)];
+		if(e->page == page && e->last == t) {
+			k++;
+			e->last = k;
+			s->at[k] = page;
+		}
+	}
+
+	// every live time holds a 1: build the tree in linear time
+	s->size = size;
+	for(t=1;t<=s->size;t++) s->tree[t] = 0;
+	for(t=1;t<=s->size;t++) {
+		if(t<=k) s->tree[t] += 1;
+		int parent = t + (t & -t);
+		if(parent<=s->size) s->tree[parent] += s->tree[t];
+	}
+
+	s->now = k+1;
+
+	return 0;
+}
+
+
+
+/* Double the table of tracked pages. Returns 0 on success, -1 on failure. */
+static int table_grow( struct shards *s )
+{
+	int i;
+	struct shards_entry *old = s->table;
+	int old_capacity = s->capacity;
+
+	s->table = malloc(2 * old_capacity * sizeof(struct shards_entry));
+	if(!s->table) {
+		s->table = old;
+		return -1;
+	}
+
+	s->capacity = 2 * old_capacity;
+	for(i=0;i<s->capacity;i++) s->table[i].page = -1;
+
+	for(i=0;i<old_capacity;i++) {
+		if(old[i].page >= 0) s->table[table_find(s, old[i].page)] = old[i];
+	}
+
+	free(old);
+
+	return 0;
+}
+
+
+
+/* Push a page onto the max-heap of tracked pages. */
+static void heap_push( struct shards *s, int page )
+{
+	int i = s->tracked - 1;		// the page is already counted as tracked
+	int h = page_hash(page);
+
+	while(i>0 && page_hash(s->heap[(i-1)/2]) < h) {
+		s->heap[i] = s->heap[(i-1)/2];
+		i = (i-1)/2;
+	}
+
+	s->heap[i] = page;
+}
+
+
+
+/* Remove the page with the largest hash from the max-heap of "n" pages. */
+static int heap_pop( struct shards *s, int n )
+{
+	int top = s->heap[0];
+	int last = s->heap[n-1];
+	int h = page_hash(last);
+	int i = 0;
+
+	n--;
+	while(2*i+1 < n) {
+		int child = 2*i+1;
+		if(child+1 < n && page_hash(s->heap[child+1]) > page_hash(s->heap[child])) child++;
+		if(page_hash(s->heap[child]) <= h) break;
+		s->heap[i] = s->heap[child];
+		i = child;
+	}
+
+	if(n>0) s->heap[i] = last;
+
+	return top;
+}
+
+
+
+/* Scale every count gathered so far by "f", when the sampling rate is lowered. */
+static void rescale( struct shards *s, double f )
+{
+	int d;
+
+	for(d=1;d<=s->maxframes;d++) s->hist[d] *= f;
+	s->cold *= f;
+	s->beyond *= f;
+	s->total *= f;
+}
+
+
+
+/*
+Fixed size mode: lower the threshold to the largest hash of a tracked page, which stops sampling that page
+and every other page with the same hash.
+*/
+static void lower_threshold( struct shards *s )
+{
+	int h = page_hash(s->heap[0]);
+	double old_rate = shards_rate(s);
+
+	while(s->tracked > 0 && page_hash(s->heap[0]) == h) {
+		int page = heap_pop(s, s->tracked);
+		int i = table_find(s, page);
+
+		tree_add(s, s->table[i].last, -1);
+		table_remove(s, i);
+		s->tracked--;
+	}
+
+	s->threshold = h;
+	rescale(s, shards_rate(s) / old_rate);
+}
+
+
+
+/*
+Create an empty estimate sampling pages at "rate" (0 < rate <= 1), for memories of up to "maxframes" frames.
+Returns a pointer to the new estimate, or null on failure.
+*/
+struct shards * shards_create( double rate, int max_pages, int maxframes )
+{
+	int i;
+	struct shards *s = calloc(1, sizeof(*s));
+	if(!s) return 0;
+
+	s->threshold = rate >= 1 ? SHARDS_MODULUS : (int) (rate * SHARDS_MODULUS);
+	if(s->threshold < 1) s->threshold = 1;
+	s->max_pages = max_pages > 0 ? max_pages : 0;
+	s->maxframes = maxframes;
+
+	// in fixed size mode the table never has to grow
+	s->capacity = 1024;
+	while(s->max_pages && s->capacity < 2*s->max_pages) s->capacity *= 2;
+
+	s->size = s->capacity;
+	s->now = 1;
+
+	s->hist = calloc(maxframes+1, sizeof(double));
+	s->table = malloc(s->capacity * sizeof(struct shards_entry));
+	s->heap = s->max_pages ? malloc((s->max_pages+1) * sizeof(int)) : NULL;
+	s->at = malloc((s->size+1) * sizeof(int));
+	s->tree = calloc(s->size+1, sizeof(int));
+
+	if(!s->hist || !s->table || (s->max_pages && !s->heap) || !s->at || !s->tree) {
+		shards_delete(s);
+		return 0;
+	}
+
+	for(i=0;i<s->capacity;i++) s->table[i].page = -1;
+
+	return s;
+}
+
+
+
+/* Delete an estimate and free its memory. */
+void shards_delete( struct shards *s )
+{
+	free(s->hist);
+	free(s->table);
+	free(s->heap);
+	free(s->at);
+	free(s->tree);
+	free(s);
+}
+
+
+
+/* Add a reference to "page" to the estimate. */
+void shards_reference( struct shards *s, int page )
+{
+	s->nrefs++;
+
+	if(page_hash(page) >= s->threshold) return;		// not in the sample
+
+	s->sampled++;
+	s->total += 1;
+
+	// time runs out: renumber, and make room for the table's worth of pages twice over
+	if(s->now > s->size) compact(s, s->capacity);
+
+	int added = 0;		// 1 if the page is new to the sample
+	struct shards_entry *e = &s->table[table_find(s, page)];
+
+	if(e->page == page) {
+		// sampled distinct pages referenced since the last reference to this one, scaled up to all pages
+		int distance = tree_sum(s, s->now-1) - tree_sum(s, e->last) + 1;
+		double estimate = ceil(distance / shards_rate(s) - 1e-9);
+
+		if(estimate <= s->maxframes) s->hist[(int) estimate] += 1;
+		else s->beyond += 1;
+
+		tree_add(s, e->last, -1);
+	} else {
+		s->cold += 1;
+
+		e->page = page;
+		e->last = 0;
+		s->tracked++;
+		added = 1;
+
+		// fixed rate: keep the table at most half full, it needs a tree as big as itself
+		if(!s->max_pages && 2*s->tracked > s->capacity) {
+			if(table_grow(s) < 0 || compact(s, s->capacity) < 0) {
+				printf("Error allocating space for the sampled pages!\n");
+				exit(1);
+			}
+			e = &s->table[table_find(s, page)];
+		}
+	}
+
+	tree_add(s, s->now, 1);
+	e->last = s->now;
+	s->at[s->now] = page;
+	s->now++;
+
+	// fixed size: one page too many, drop the ones with the largest hash, possibly this one
+	if(s->max_pages && added) {
+		heap_push(s, page);
+		if(s->tracked > s->max_pages) lower_threshold(s);
+	}
+}
+
+
+
+/* Return the number of references added to the estimate, sampled or not. */
+long shards_nrefs( struct shards *s )
+{
+	return s->nrefs;
+}
+
+
+
+/* Return the number of references which were sampled. */
+long shards_sampled( struct shards *s )
+{
+	return s->sampled;
+}
+
+
+
+/* Return the number of distinct pages currently in the sample. */
+int shards_tracked( struct shards *s )
+{
+	return s->tracked;
+}
+
+
+
+/* Return the current sampling rate. */
+double shards_rate( struct shards *s )
+{
+	return (double) s->threshold / SHARDS_MODULUS;
+}
+
+
+
+/*
+Fill misses[c-1] with the estimated misses of LRU on a memory of c frames, for every c from 1 to "maxframes",
+and error[c-1] with a heuristic size of the error of the estimated miss ratio, not a bound on it.
+*/
+void shards_curve( struct shards *s, double *misses, double *error, int maxframes )
+{
+	int c;
+	double total = s->total;
+
+	// the miss ratio is estimated as the ratio of the sampled weights. SHARDS-adj, which moves the difference
+	// between the expected and the sampled no of references to the smallest distance, made the estimates
+	// of the mixed and focus programs worse, so it is not done.
+
+	double beyond = s->cold + s->beyond;	// misses of a memory of maxframes frames
+
+	for(c=s->maxframes;c>=1;c--) {
+		double ratio = total > 0 ? beyond / total : 0;
+		if(ratio > 1) ratio = 1;
+
+		if(c<=maxframes) {
+			misses[c-1] = ratio * s->nrefs;
+			error[c-1] = s->tracked > 0 ? 1.96 * sqrt(ratio * (1-ratio) / s->tracked) : 1;
+		}
+
+		beyond += s->hist[c];
+	}
+}
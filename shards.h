@@ -0,0 +1,71 @@
+#ifndef SHARDS_H
+#define SHARDS_H
+
+
+
+/*
+An estimate of the LRU miss-ratio curve from a spatially hashed sample of the pages (SHARDS, Waldspurger et al.).
+A page is sampled if a hash of its number falls below a threshold, so every reference to a sampled page is seen
+and none of the others. The stack distances among the sampled pages, divided by the sampling rate, estimate
+the stack distances of the whole stream (see mrc.h), while only the sampled pages are tracked.
+
+With a fixed rate, the memory used grows with the number of distinct sampled pages.
+With a fixed size, at most "max_pages" pages are tracked: when one more would be, the threshold is lowered
+to drop the sampled page with the largest hash, and the counts gathered so far are scaled down to the new rate.
+*/
+struct shards;
+
+
+
+/*
+Create an empty estimate sampling pages at "rate" (0 < rate <= 1), for memories of up to "maxframes" frames.
+If "max_pages" is more than 0 the sample is of fixed size: the rate is lowered as needed to track at most "max_pages" pages.
+Returns a pointer to the new estimate, or null on failure.
+*/
+struct shards * shards_create( double rate, int max_pages, int maxframes );
+
+
+
+/* Delete an estimate and free its memory. */
+void shards_delete( struct shards *s );
+
+
+
+/* Add a reference to "page" to the estimate. */
+void shards_reference( struct shards *s, int page );
+
+
+
+/* Return the number of references added to the estimate, sampled or not. */
+long shards_nrefs( struct shards *s );
+
+
+
+/* Return the number of references which were sampled. */
+long shards_sampled( struct shards *s );
+
+
+
+/* Return the number of distinct pages currently in the sample. */
+int shards_tracked( struct shards *s );
+
+
+
+/* Return the current sampling rate. */
+double shards_rate( struct shards *s );
+
+
+
+/*
+Fill misses[c-1] with the estimated misses of LRU on a memory of c frames, for every c from 1 to "maxframes",
+and error[c-1] with a heuristic size of the error of the estimated miss ratio, not a bound on it.
+It is 1.96 standard errors of a proportion over the tracked pages, as if every page were one independent draw
+with the curve's miss ratio. Pages differ much more than that in how many references and misses they have,
+so the exact miss ratio can be well outside it: 0.804 against 0.737 +- 0.066 for mixed at 100 of 2000 frames, rate 0.1.
+"maxframes" must not be more than it was when the estimate was created.
+*/
+void shards_curve( struct shards *s, double *misses, double *error, int maxframes );
+
+
+
+#endif
@@ -0,0 +1,158 @@
+#include "swap_map.h"
+
+#include <stdlib.h>
+
+
+
+#define SEGMENT_SLOTS	16		// slots in a segment
+
+
+
+// structure holding a map
+struct swap_map {
+	int npages;
+	int nslots;
+	int nsegments;
+	int *page_slot;			// slot of every page, -1 if none
+	int *slot_page;			// page in every slot, -1 if it is free
+	int *live;			// no of slots in use in every segment
+	int segment;			// segment at the head of the log, -1 before the first write
+	int next;			// next slot of that segment to try
+	int last;			// slot handed out last, -1 if none
+	struct swap_map_stats stats;
+};
+
+
+
+/*
+Create a map for the pages 0 .. npages-1 on a disk of "nslots" slots, which must be more than npages.
+Returns a pointer to the new map, or null on failure.
+*/
+struct swap_map * swap_map_create( int npages, int nslots )
+{
+	int i;
+	struct swap_map *m = calloc(1, sizeof(*m));
+	if(!m) return 0;
+
+	// only whole segments are used
+	m->npages = npages;
+	m->nsegments = nslots / SEGMENT_SLOTS;
+	m->nslots = m->nsegments * SEGMENT_SLOTS;
+	m->segment = -1;
+	m->last = -1;
+
+	m->page_slot = malloc(npages * sizeof(int));
+	m->slot_page = malloc(m->nslots * sizeof(int));
+	m->live = calloc(m->nsegments, sizeof(int));
+
+	if(!m->page_slot || !m->slot_page || !m->live || m->nslots <= npages) {
+		swap_map_delete(m);
+		return 0;
+	}
+
+	for(i=0;i<m->nslots;i++) m->slot_page[i] = i < npages ? i : -1;
+	for(i=0;i<npages;i++) {
+		m->page_slot[i] = i;
+		m->live[i / SEGMENT_SLOTS]++;
+	}
+	m->stats.live = npages;
+
+	return m;
+}
+
+
+
+/* Delete a map and free its memory. */
+void swap_map_delete( struct swap_map *m )
+{
+	free(m->page_slot);
+	free(m->slot_page);
+	free(m->live);
+	free(m);
+}
+
+
+
+/* Return the slot holding the contents of "page", or -1 if there is none. */
+int swap_map_slot( struct swap_map *m, int page )
+{
+	return m->page_slot[page];
+}
+
+
+
+/* Free the slot of "page", its copy on disk is out of date. */
+void swap_map_release( struct swap_map *m, int page )
+{
+	int slot = m->page_slot[page];
+
+	if(slot < 0) return;
+
+	m->slot_page[slot] = -1;
+	m->live[slot / SEGMENT_SLOTS]--;
+	m->page_slot[page] = -1;
+	m->stats.live--;
+}
+
+
+
+/* Move the head of the log to the next empty segment after it, or else to the segment with the fewest slots in use. */
+static void next_segment( struct swap_map *m )
+{
+	int i, best = -1;
+	int start = m->segment + 1;
+
+	for(i=0;i<m->nsegments;i++) {
+		int s = (start + i) % m->nsegments;
+
+		if(m->live[s] == 0) {
+			m->segment = s;
+			m->next = 0;
+			m->stats.segments++;
+			return;
+		}
+		if(s != m->segment && (best < 0 || m->live[s] < m->live[best])) best = s;
+	}
+
+	// there are more slots than pages, so some segment other than the head has a free slot
+	m->segment = best;
+	m->next = 0;
+	m->stats.reused++;
+}
+
+
+
+/* Take a slot at the head of the log for the next copy of "page" and return it. The slot it was in is freed. */
+int swap_map_assign( struct swap_map *m, int page )
+{
+	int slot;
+
+	swap_map_release(m, page);
+
+	// skip the slots of the head segment still in use, they only exist when it is being reused
+	for(;;) {
+		if(m->segment < 0 || m->next == SEGMENT_SLOTS) next_segment(m);
+
+		slot = m->segment * SEGMENT_SLOTS + m->next++;
+		if(m->slot_page[slot] < 0) break;
+	}
+
+	m->slot_page[slot] = page;
+	m->page_slot[page] = slot;
+	m->live[m->segment]++;
+	m->stats.live++;
+
+	m->stats.writes++;
+	if(m->last < 0 || slot != m->last + 1) m->stats.runs++;
+	m->last = slot;
+
+	return slot;
+}
+
+
+
+/* Fill "stats" with the statistics of a map. */
+void swap_map_get_stats( struct swap_map *m, struct swap_map_stats *stats )
+{
+	*stats = m->stats;
+}
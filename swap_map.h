@@ -0,0 +1,64 @@
+#ifndef SWAP_MAP_H
+#define SWAP_MAP_H
+
+
+
+/*
+A map from the pages of the virtual memory to the slots of the disk holding their contents, filled like a log.
+Every time a page is written it goes to a new slot at the head of the log instead of its own block, so pages
+written one after the other, whichever they are, land in consecutive slots and are written sequentially.
+The slots are grouped into segments: the log fills one segment, then moves on to the next empty one.
+A slot is freed when its page is written elsewhere, or as soon as the page changes in memory, since then the
+copy on disk is out of date. When no segment is empty, the log fills the holes of the segment with the fewest
+slots in use, which reclaims their space without moving any page.
+*/
+struct swap_map;
+
+
+
+// statistics of a map
+struct swap_map_stats {
+	long writes;			// no of slots handed out
+	long runs;			// no of runs of consecutive slots among them
+	long segments;			// no of empty segments the log moved on to
+	long reused;			// no of segments with holes the log had to fill
+	int live;			// no of slots in use now
+};
+
+
+
+/*
+Create a map for the pages 0 .. npages-1 on a disk of "nslots" slots, which must be more than npages.
+At first every page is in the slot with its own number.
+Returns a pointer to the new map, or null on failure.
+*/
+struct swap_map * swap_map_create( int npages, int nslots );
+
+
+
+/* Delete a map and free its memory. */
+void swap_map_delete( struct swap_map *m );
+
+
+
+/* Return the slot holding the contents of "page", or -1 if there is none. */
+int swap_map_slot( struct swap_map *m, int page );
+
+
+
+/* Take a slot at the head of the log for the next copy of "page" and return it. The slot it was in is freed. */
+int swap_map_assign( struct swap_map *m, int page );
+
+
+
+/* Free the slot of "page", its copy on disk is out of date. */
+void swap_map_release( struct swap_map *m, int page );
+
+
+
+/* Fill "stats" with the statistics of a map. */
+void swap_map_get_stats( struct swap_map *m, struct swap_map_stats *stats );
+
+
+
+#endif
@@ -0,0 +1,323 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+
+#define TRACE_VERSION		1
+#define TRACE_BUFFER_SIZE	(1<<16)		// bytes gathered before a write, or the first size of the mapped file
+#define TRACE_MAX_RECORD	21		// tag byte and two varints of at most 10 bytes each
+
+
+
+// structure holding an open trace file
+struct trace {
+	int fd;			// the trace file
+	int use_mmap;		// 1 if the file is mapped, 0 if it is written through buf
+	unsigned char *buf;	// the write buffer, or the mapped file
+	long size;		// bytes available in buf
+	long used;		// bytes of buf filled so far
+	long offset;		// file offset of buf[0] in mmap mode, always 0 in buffered mode
+	int error;		// 1 once a write failed, later records are dropped
+	long count;		// no of records appended
+	long long last_ns;	// time of the previous record
+	int last_page;		// page of the previous record
+};
+
+
+
+/* Return the current time in nanoseconds. */
+static long long now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+
+
+/* Store "v" as a varint at "p", returns the number of bytes used. */
+static int put_varint( unsigned char *p, unsigned long long v )
+{
+	int n = 0;
+
+	while(v >= 0x80) {
+		p[n++] = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	p[n++] = v;
+
+	return n;
+}
+
+
+
+/* Write all of buf to the trace file in buffered mode. */
+static void flush_buffer( struct trace *t )
+{
+	long done = 0;
+
+	while(done < t->used && !t->error) {
+		ssize_t n = write(t->fd, t->buf + done, t->used - done);
+		if(n <= 0) t->error = 1;
+		else done += n;
+	}
+
+	t->used = 0;
+}
+
+
+
+/* Map the next window of the trace file in mmap mode, twice as big as the last one, starting where the last one was filled up to. */
+static void grow_mapping( struct trace *t )
+{
+	long page = sysconf(_SC_PAGESIZE);
+	long end = t->offset + t->used;
+	long start = end / page * page;		// mappings must start on a page boundary
+	long size = t->size * 2;
+
+	munmap(t->buf, t->size);
+
+	if(ftruncate(t->fd, start + size) < 0) {
+		t->buf = NULL;
+		t->error = 1;
+		return;
+	}
+
+	t->buf = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, t->fd, start);
+	if(t->buf == MAP_FAILED) {
+		t->buf = NULL;
+		t->error = 1;
+		return;
+	}
+
+	t->offset = start;
+	t->used = end - start;
+	t->size = size;
+}
+
+
+
+/*
+Create the trace file "filename" for a virtual memory of "npages" pages.
+Returns a pointer to the new trace, or null on failure.
+*/
+struct trace * trace_create( const char *filename, int npages, int use_mmap )
+{
+	struct trace *t = calloc(1, sizeof(*t));
+	if(!t) return 0;
+
+	t->fd = open(filename, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	if(t->fd < 0) {
+		free(t);
+		return 0;
+	}
+
+	t->use_mmap = use_mmap;
+	t->size = TRACE_BUFFER_SIZE;
+
+	if(use_mmap) {
+		if(ftruncate(t->fd, t->size) < 0) t->buf = MAP_FAILED;
+		else t->buf = mmap(NULL, t->size, PROT_READ|PROT_WRITE, MAP_SHARED, t->fd, 0);
+		if(t->buf == MAP_FAILED) t->buf = NULL;
+	} else {
+		t->buf = malloc(t->size);
+	}
+
+	if(!t->buf) {
+		close(t->fd);
+		unlink(filename);
+		free(t);
+		return 0;
+	}
+
+	// header: magic, version and no of pages
+	memcpy(t->buf, "VMTR", 4);
+	t->buf[4] = TRACE_VERSION;
+	t->used = 5 + put_varint(t->buf + 5, npages);
+
+	t->last_ns = now_ns();
+	t->last_page = 0;
+
+	return t;
+}
+
+
+
+/* Append a record of "event" on "page" to the trace, "write" is 1 for a write reference and 0 for a read. */
+void trace_record( struct trace *t, int event, int page, int write )
+{
+	long long ns = now_ns();
+	int delta = page - t->last_page;
+
+	if(t->size - t->used < TRACE_MAX_RECORD) {
+		if(t->use_mmap) grow_mapping(t);
+		else flush_buffer(t);
+	}
+	if(t->error) return;
+
+	unsigned char *p = t->buf + t->used;
+
+	p[0] = event | (write ? TRACE_WRITE : 0);
+	int n = 1;
+	n += put_varint(p + n, ns - t->last_ns);
+	n += put_varint(p + n, ((unsigned) delta << 1) ^ (unsigned) (delta >> 31));	// zigzag: small negative deltas stay small
+
+	t->used += n;
+	t->count++;
+	t->last_ns = ns;
+	t->last_page = page;
+}
+
+
+
+/* Return the number of records appended to the trace so far. */
+long trace_count( struct trace *t )
+{
+	return t->count;
+}
+
+
+
+/* Write out whatever is left, close the trace file and free the trace. Returns 0 on success, -1 on a write error. */
+int trace_close( struct trace *t )
+{
+	if(t->use_mmap) {
+		if(t->buf) munmap(t->buf, t->size);
+
+		// cut off the unused end of the last window
+		if(!t->error && ftruncate(t->fd, t->offset + t->used) < 0) t->error = 1;
+	} else {
+		flush_buffer(t);
+		free(t->buf);
+	}
+
+	if(close(t->fd) < 0) t->error = 1;
+
+	int result = t->error ? -1 : 0;
+	free(t);
+
+	return result;
+}
+
+
+
+// structure holding a trace file opened for reading
+struct trace_reader {
+	const unsigned char *data;	// the mapped file
+	long size;			// length of the file
+	long pos;			// offset of the next record
+	int npages;			// no of pages of the traced memory
+	int page;			// page of the previous record
+};
+
+
+
+/* Read a varint at "pos" into "v". Returns 0 on success, -1 if it runs past the end of the file. */
+static int get_varint( struct trace_reader *r, unsigned long long *v )
+{
+	unsigned long long x = 0;
+	int shift = 0;
+
+	while(r->pos < r->size && shift < 64) {
+		unsigned char b = r->data[r->pos++];
+		x |= (unsigned long long) (b & 0x7f) << shift;
+		if(b < 0x80) {
+			*v = x;
+			return 0;
+		}
+		shift += 7;
+	}
+
+	return -1;
+}
+
+
+
+/*
+Open the trace file "filename" for reading.
+Returns a pointer to the new reader, or null if the file cannot be opened or is not a trace.
+*/
+struct trace_reader * trace_open( const char *filename )
+{
+	unsigned long long npages;
+	struct trace_reader *r = calloc(1, sizeof(*r));
+	if(!r) return 0;
+
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		free(r);
+		return 0;
+	}
+
+	r->size = lseek(fd, 0, SEEK_END);
+	if(r->size >= 5) r->data = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);		// the mapping keeps the file open
+
+	if(r->size < 5 || r->data == MAP_FAILED) {
+		free(r);
+		return 0;
+	}
+
+	// the file is read front to back exactly once
+	madvise((void *) r->data, r->size, MADV_SEQUENTIAL);
+
+	r->pos = 5;
+	if(memcmp(r->data, "VMTR", 4) || r->data[4] != TRACE_VERSION || get_varint(r, &npages) < 0 || npages > 0x7fffffff) {
+		munmap((void *) r->data, r->size);
+		free(r);
+		return 0;
+	}
+	r->npages = npages;
+
+	return r;
+}
+
+
+
+/* Return the number of pages of the virtual memory the trace was recorded on. */
+int trace_npages( struct trace_reader *r )
+{
+	return r->npages;
+}
+
+
+
+/*
+Read the next record of the trace into "event", "page" and "write".
+Returns 1 if a record was read, 0 at the end of the trace, -1 if the trace is cut off or a page is out of range.
+*/
+int trace_next( struct trace_reader *r, int *event, int *page, int *write )
+{
+	unsigned long long ns, zigzag;
+
+	if(r->pos >= r->size) return 0;
+
+	int tag = r->data[r->pos++];
+
+	if(get_varint(r, &ns) < 0 || get_varint(r, &zigzag) < 0) return -1;
+
+	// undo the zigzag encoding of the page delta
+	r->page += (int) ((zigzag >> 1) ^ -(zigzag & 1));
+	if(r->page < 0 || r->page >= r->npages) return -1;
+
+	*event = tag & 3;
+	*write = (tag & TRACE_WRITE) != 0;
+	*page = r->page;
+
+	return 1;
+}
+
+
+
+/* Close the trace file and free the reader. */
+void trace_reader_close( struct trace_reader *r )
+{
+	munmap((void *) r->data, r->size);
+	free(r);
+}
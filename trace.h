@@ -0,0 +1,88 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+
+
+/*
+A recorder of page references into a compact binary trace file, for studying access patterns offline.
+
+The file starts with the 4 byte magic "VMTR", a version byte and the number of pages as a varint.
+Every record after it is:
+	one tag byte:	the event (TRACE_ACCESS, TRACE_FAULT_MAJOR or TRACE_FAULT_PROT) in the low two bits,
+			TRACE_WRITE in bit 2 if the reference was a write
+	a varint:	nanoseconds since the previous record
+	a varint:	the page minus the page of the previous record, zigzag encoded
+Varints are little endian groups of 7 bits, the high bit of a byte set if more bytes follow.
+Consecutive references mostly stay close in time and space, so a typical record takes 3 to 5 bytes.
+*/
+struct trace;
+
+
+
+// trace events
+#define TRACE_ACCESS		0	// a reference reported by a program
+#define TRACE_FAULT_MAJOR	1	// a fault on a page not in memory, which reads it from disk
+#define TRACE_FAULT_PROT	2	// a fault on a page in memory without the needed permission
+
+// flag or'ed into the tag byte of a write reference
+#define TRACE_WRITE		4
+
+
+
+/*
+Create the trace file "filename" for a virtual memory of "npages" pages.
+Records are gathered in a buffer and written out in large blocks, or, if "use_mmap" is 1,
+stored straight into the file mapped in memory, which is grown as needed.
+Returns a pointer to the new trace, or null on failure.
+*/
+struct trace * trace_create( const char *filename, int npages, int use_mmap );
+
+
+
+/* Append a record of "event" on "page" to the trace, "write" is 1 for a write reference and 0 for a read. */
+void trace_record( struct trace *t, int event, int page, int write );
+
+
+
+/* Return the number of records appended to the trace so far. */
+long trace_count( struct trace *t );
+
+
+
+/* Write out whatever is left, close the trace file and free the trace. Returns 0 on success, -1 on a write error. */
+int trace_close( struct trace *t );
+
+
+
+/* A trace file opened for reading, mapped in memory as a whole. */
+struct trace_reader;
+
+
+
+/*
+Open the trace file "filename" for reading.
+Returns a pointer to the new reader, or null if the file cannot be opened or is not a trace.
+*/
+struct trace_reader * trace_open( const char *filename );
+
+
+
+/* Return the number of pages of the virtual memory the trace was recorded on. */
+int trace_npages( struct trace_reader *r );
+
+
+
+/*
+Read the next record of the trace into "event", "page" and "write".
+Returns 1 if a record was read, 0 at the end of the trace, -1 if the trace is cut off or a page is out of range.
+*/
+int trace_next( struct trace_reader *r, int *event, int *page, int *write );
+
+
+
+/* Close the trace file and free the reader. */
+void trace_reader_close( struct trace_reader *r );
+
+
+
+#endif
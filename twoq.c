@@ -0,0 +1,162 @@
+#include "twoq.h"
+#include "lru.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+// structure holding the state of the 2Q queues
+struct twoq {
+	int c;				// no of frames
+	int kin;			// target size of a1in, a quarter of the frames
+	int kout;			// size of a1out, half the frames
+	struct lru_list *a1in;		// resident pages seen once, in FIFO order (never touched on a hit)
+	struct lru_list *a1out;		// ghosts of pages evicted from a1in, in FIFO order
+	struct lru_list *am;		// resident hot pages, in LRU order
+	int promotions;			// no of pages which faulted while in a1out and were moved to am
+};
+
+
+
+/*
+Create a 2Q for a memory of "nframes" frames over "npages" pages.
+Returns a pointer to the new 2Q, or null on failure.
+*/
+struct twoq * twoq_create( int npages, int nframes )
+{
+	struct twoq *q;
+
+	q = malloc(sizeof(*q));
+	if(!q) return 0;
+
+	// sizes recommended in the 2Q paper
+	q->c = nframes;
+	q->kin = nframes/4 > 0 ? nframes/4 : 1;
+	q->kout = nframes/2 > 0 ? nframes/2 : 1;
+	q->promotions = 0;
+
+	q->a1in = lru_create(npages);
+	q->a1out = lru_create(npages);
+	q->am = lru_create(npages);
+
+	if(!q->a1in || !q->a1out || !q->am) {
+		twoq_delete(q);
+		return 0;
+	}
+
+	return q;
+}
+
+
+
+/* Delete a 2Q and free its memory. */
+void twoq_delete( struct twoq *q )
+{
+	if(q->a1in) lru_delete(q->a1in);
+	if(q->a1out) lru_delete(q->a1out);
+	if(q->am) lru_delete(q->am);
+	free(q);
+}
+
+
+
+/* Tell the 2Q that a resident page has been accessed again. Does nothing if the page is not resident. */
+void twoq_hit( struct twoq *q, int page )
+{
+	if(lru_contains(q->a1in, page)) {
+		// the original 2Q ignores hits in a1in because of correlated references, but the programs already
+		// report a run of accesses to one page as a single reference, so a second reference makes the page hot
+		lru_remove(q->a1in, page);
+		lru_insert(q->am, page);
+		q->promotions++;
+	} else {
+		lru_touch(q->am, page);
+	}
+}
+
+
+
+/* Choose a resident page to evict, preferring the FIFO of new pages while it is over its target. */
+static int twoq_reclaim( struct twoq *q )
+{
+	int victim;
+
+	if(lru_size(q->a1in) > q->kin || lru_size(q->am) == 0) {
+		victim = lru_oldest(q->a1in);
+		lru_remove(q->a1in, victim);
+
+		// remember it, forgetting the oldest ghost if a1out is full
+		if(lru_size(q->a1out) >= q->kout) lru_remove(q->a1out, lru_oldest(q->a1out));
+		lru_insert(q->a1out, victim);
+	} else {
+		victim = lru_oldest(q->am);
+		lru_remove(q->am, victim);
+	}
+
+	return victim;
+}
+
+
+
+/*
+Tell the 2Q that a page has faulted and is being brought in.
+Returns the resident page which has to be evicted to make room for it, or -1 if there is still a free frame.
+*/
+int twoq_miss( struct twoq *q, int page )
+{
+	int victim = -1;
+
+	if(lru_size(q->a1in) + lru_size(q->am) >= q->c) victim = twoq_reclaim(q);
+
+	if(lru_contains(q->a1out, page)) {
+		// seen again soon after its first use: it is hot
+		lru_remove(q->a1out, page);
+		lru_insert(q->am, page);
+		q->promotions++;
+	} else {
+		lru_insert(q->a1in, page);
+	}
+
+	return victim;
+}
+
+
+
+/*
+Evict one more resident page ahead of a miss, when memory is reclaimed in batches, but never "keep":
+the page whose miss was just handled, which is in the queues but not yet in memory. Returns the evicted page.
+*/
+int twoq_evict( struct twoq *q, int keep )
+{
+	int victim;
+
+	if(lru_size(q->am) > 0 && lru_oldest(q->am) == keep) {
+		// the page was promoted straight to am and is its only page
+		victim = lru_oldest(q->a1in);
+		lru_remove(q->a1in, victim);
+		if(lru_size(q->a1out) >= q->kout) lru_remove(q->a1out, lru_oldest(q->a1out));
+		lru_insert(q->a1out, victim);
+	} else {
+		victim = twoq_reclaim(q);
+	}
+
+	return victim;
+}
+
+
+
+/* Return 1 if a page is in a1in or am. */
+int twoq_resident( struct twoq *q, int page )
+{
+	return lru_contains(q->a1in, page) || lru_contains(q->am, page);
+}
+
+
+
+/* Print the queue sizes and how many pages were promoted to the hot list. */
+void twoq_print_stats( struct twoq *q )
+{
+	printf("2Q: A1in %d, A1out %d, Am %d pages, %d promotions to Am\n",
+		lru_size(q->a1in), lru_size(q->a1out), lru_size(q->am), q->promotions);
+}
@@ -0,0 +1,62 @@
+#ifndef TWOQ_H
+#define TWOQ_H
+
+
+
+/*
+Full 2Q replacement (Johnson and Shasha), a scan resistant variant of LRU.
+A page faulted in for the first time goes to the FIFO queue A1in. When it is evicted from there, only its number is
+remembered in the ghost queue A1out. Only a page which is referenced again while it is in A1in, or faults again while
+it is in A1out, is considered hot and goes to the LRU list Am. A one time sequential sweep therefore passes through A1in and A1out without ever touching Am,
+so it cannot flush the hot set. All operations are constant time.
+*/
+struct twoq;
+
+
+
+/*
+Create a 2Q for a memory of "nframes" frames over "npages" pages.
+Returns a pointer to the new 2Q, or null on failure.
+*/
+struct twoq * twoq_create( int npages, int nframes );
+
+
+
+/* Delete a 2Q and free its memory. */
+void twoq_delete( struct twoq *q );
+
+
+
+/* Tell the 2Q that a resident page has been accessed again. Does nothing if the page is not resident. */
+void twoq_hit( struct twoq *q, int page );
+
+
+
+/*
+Tell the 2Q that a page has faulted and is being brought in.
+Returns the resident page which has to be evicted to make room for it, or -1 if there is still a free frame.
+*/
+int twoq_miss( struct twoq *q, int page );
+
+
+
+/*
+Evict one more resident page ahead of a miss, when memory is reclaimed in batches, but never "keep":
+the page whose miss was just handled, which is in the queues but not yet in memory. Returns the evicted page.
+At least one resident page besides "keep" must be left.
+*/
+int twoq_evict( struct twoq *q, int keep );
+
+
+
+/* Return 1 if a page is in A1in or Am: resident, or its miss has been handled and it is being brought in. */
+int twoq_resident( struct twoq *q, int page );
+
+
+
+/* Print the queue sizes and how many pages were promoted to the hot list. */
+void twoq_print_stats( struct twoq *q );
+
+
+
+#endif
@@ -0,0 +1,293 @@
+#include "ztier.h"
+#include "lz.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+
+#define ZT_CLASS_SIZE	64		// size classes are this many bytes apart
+#define ZT_SLAB_PAGES	4		// pages of memory in a slab
+
+
+
+// a slab: objects of one size class
+struct zslab {
+	struct zslab *prev, *next;	// in the list of slabs of its class with a free object
+	int nused;			// no of objects in use
+	int free_head;			// first free object, -1 if none
+	short *next_free;		// next_free[i] is the free object after object i
+	char *data;			// the objects
+};
+
+
+
+// a page held by the tier
+struct zentry {
+	struct zslab *slab;		// slab holding the page, null if the tier does not hold it
+	short index;			// object of the slab holding the page
+	short size;			// compressed size
+	char dirty;			// 1 if the page must be written to disk when it leaves the tier
+	int older, newer;		// neighbours in the order the pages were stored, -1 at the ends
+};
+
+
+
+// structure holding a tier
+struct ztier {
+	long budget;			// most memory the slabs may take
+	int npages;
+	int page_size;
+	int slab_size;			// bytes of objects in a slab
+	int nclasses;
+	void (*spill)( int page, const char *data, int dirty );
+
+	struct zslab **partial;		// partial[c] is the list of slabs of class c with a free object
+	struct zentry *entries;		// one for every page
+	int oldest, newest;		// ends of the list of pages held, -1 if it is empty
+	char *buffer;			// a page compressed, or decompressed to be spilled
+
+	struct ztier_stats stats;
+};
+
+
+
+/* Return the no of objects of class "c" in a slab. */
+static int class_objects( struct ztier *z, int c )
+{
+	return z->slab_size / ((c+1) * ZT_CLASS_SIZE);
+}
+
+
+
+/* Add "s" to the list of slabs of class "c" with a free object. */
+static void partial_add( struct ztier *z, int c, struct zslab *s )
+{
+	s->prev = NULL;
+	s->next = z->partial[c];
+	if(s->next) s->next->prev = s;
+	z->partial[c] = s;
+}
+
+
+
+/* Remove "s" from the list of slabs of class "c" with a free object. */
+static void partial_remove( struct ztier *z, int c, struct zslab *s )
+{
+	if(s->prev) s->prev->next = s->next;
+	else z->partial[c] = s->next;
+	if(s->next) s->next->prev = s->prev;
+}
+
+
+
+/* Create a slab of class "c" and add it to the list of its class. Returns 0 if it is over the budget or memory runs out. */
+static struct zslab * slab_create( struct ztier *z, int c )
+{
+	int i, n = class_objects(z, c);
+
+	if(z->stats.memory + z->slab_size > z->budget) return 0;
+
+	struct zslab *s = malloc(sizeof(struct zslab) + n * sizeof(short) + z->slab_size);
+	if(!s) return 0;
+
+	s->next_free = (short *) (s + 1);
+	s->data = (char *) (s->next_free + n);
+	s->nused = 0;
+	s->free_head = 0;
+	for(i=0;i<n;i++) s->next_free[i] = i+1 < n ? i+1 : -1;
+
+	partial_add(z, c, s);
+	z->stats.memory += z->slab_size;
+
+	return s;
+}
+
+
+
+/* Take the compressed copy of "page" out of its slab and out of the list of pages held, freeing the slab if it empties. */
+static void entry_remove( struct ztier *z, int page )
+{
+	struct zentry *e = &z->entries[page];
+	struct zslab *s = e->slab;
+	int c = (e->size - 1) / ZT_CLASS_SIZE;
+
+	if(s->free_head < 0) partial_add(z, c, s);		// it was full, now it has a free object
+	s->next_free[e->index] = s->free_head;
+	s->free_head = e->index;
+	s->nused--;
+
+	if(s->nused == 0) {
+		partial_remove(z, c, s);
+		free(s);
+		z->stats.memory -= z->slab_size;
+	}
+
+	if(e->older >= 0) z->entries[e->older].newer = e->newer;
+	else z->oldest = e->newer;
+	if(e->newer >= 0) z->entries[e->newer].older = e->older;
+	else z->newest = e->older;
+
+	e->slab = NULL;
+	z->stats.pages--;
+}
+
+
+
+/* Copy the compressed copy of "page" to "data" uncompressed. */
+static void entry_read( struct ztier *z, int page, char *data )
+{
+	struct zentry *e = &z->entries[page];
+	int c = (e->size - 1) / ZT_CLASS_SIZE;
+
+	lz_decompress(e->slab->data + e->index * (c+1) * ZT_CLASS_SIZE, e->size, data, z->page_size);
+}
+
+
+
+/*
+Create an empty tier for the pages 0 .. npages-1 of "page_size" bytes, using at most "budget" bytes of slabs.
+Returns a pointer to the new tier, or null on failure.
+*/
+struct ztier * ztier_create( long budget, int npages, int page_size, void (*spill)( int page, const char *data, int dirty ) )
+{
+	int i;
+	struct ztier *z = calloc(1, sizeof(*z));
+	if(!z) return 0;
+
+	z->budget = budget;
+	z->npages = npages;
+	z->page_size = page_size;
+	z->slab_size = ZT_SLAB_PAGES * page_size;
+	z->nclasses = page_size / ZT_CLASS_SIZE;
+	z->spill = spill;
+	z->oldest = z->newest = -1;
+
+	z->partial = calloc(z->nclasses, sizeof(struct zslab *));
+	z->entries = malloc(npages * sizeof(struct zentry));
+	z->buffer = malloc(page_size);
+
+	if(!z->partial || !z->entries || !z->buffer) {
+		ztier_delete(z);
+		return 0;
+	}
+
+	for(i=0;i<npages;i++) z->entries[i].slab = NULL;
+
+	return z;
+}
+
+
+
+/* Delete a tier and free its memory, the pages it holds are lost. */
+void ztier_delete( struct ztier *z )
+{
+	if(z->entries) {
+		while(z->oldest >= 0) entry_remove(z, z->oldest);
+	}
+
+	free(z->partial);
+	free(z->entries);
+	free(z->buffer);
+	free(z);
+}
+
+
+
+/*
+Compress and store "page" from "data", spilling older pages if there is not enough room.
+Returns 1 if the page was stored, 0 if it was not and must be written to disk as usual.
+*/
+int ztier_store( struct ztier *z, int page, const char *data, int dirty )
+{
+	struct zentry *e = &z->entries[page];
+	char compressed[z->page_size];
+	int size, c;
+
+	if(e->slab) entry_remove(z, page);		// an old copy
+
+	// not worth it unless it saves an eighth of the page
+	size = lz_compress(data, z->page_size, compressed, z->page_size - z->page_size/8);
+	c = (size - 1) / ZT_CLASS_SIZE;
+
+	if(size == 0 || z->slab_size > z->budget) {
+		z->stats.rejected++;
+		return 0;
+	}
+
+	// find a free object of the class, spilling the oldest pages until there is one
+	struct zslab *s = z->partial[c];
+	while(!s && !(s = slab_create(z, c))) {
+		int old = z->oldest;
+
+		if(old < 0) {
+			// nothing left to spill: out of memory
+			z->stats.rejected++;
+			return 0;
+		}
+
+		int old_dirty = z->entries[old].dirty;
+		entry_read(z, old, z->buffer);
+		entry_remove(z, old);
+		z->stats.spills++;
+		z->spill(old, z->buffer, old_dirty);
+
+		s = z->partial[c];
+	}
+
+	e->slab = s;
+	e->index = s->free_head;
+	e->size = size;
+	e->dirty = dirty;
+
+	s->free_head = s->next_free[e->index];
+	s->nused++;
+	if(s->free_head < 0) partial_remove(z, c, s);		// full
+
+	memcpy(s->data + e->index * (c+1) * ZT_CLASS_SIZE, compressed, size);
+
+	// the newest page is spilled last
+	e->newer = -1;
+	e->older = z->newest;
+	if(z->newest >= 0) z->entries[z->newest].newer = page;
+	else z->oldest = page;
+	z->newest = page;
+
+	z->stats.stores++;
+	z->stats.pages++;
+	z->stats.bytes_in += z->page_size;
+	z->stats.bytes_out += size;
+
+	return 1;
+}
+
+
+
+/*
+Load "page" into "data" and remove it from the tier, storing in "dirty" whether it has to be written to disk some day.
+Returns 1 if the tier held the page, 0 if it did not.
+*/
+int ztier_load( struct ztier *z, int page, char *data, int *dirty )
+{
+	struct zentry *e = &z->entries[page];
+
+	if(!e->slab) {
+		z->stats.misses++;
+		return 0;
+	}
+
+	entry_read(z, page, data);
+	*dirty = e->dirty;
+	entry_remove(z, page);
+	z->stats.hits++;
+
+	return 1;
+}
+
+
+
+/* Fill "stats" with the statistics of a tier. */
+void ztier_get_stats( struct ztier *z, struct ztier_stats *stats )
+{
+	*stats = z->stats;
+}
@@ -0,0 +1,69 @@
+#ifndef ZTIER_H
+#define ZTIER_H
+
+
+
+/*
+A compressed tier between the frames and the disk, in the style of zswap.
+An evicted page is compressed (see lz.h) and kept in memory, so a fault on it again is served by decompressing
+instead of reading the disk. The compressed pages are packed into slabs of a few pages, each slab holding objects of
+one size class, 64 bytes apart, and the memory of all the slabs is kept within a budget. When a page does not fit,
+the pages stored longest ago are spilled: handed back through a callback which writes them to disk if they are dirty.
+A page which does not compress to at most 7/8 of its size is not stored.
+*/
+struct ztier;
+
+
+
+// statistics of a tier
+struct ztier_stats {
+	long stores;			// no of pages stored
+	long rejected;			// no of pages not stored, they did not compress well enough or could never fit
+	long hits;			// no of loads of a page the tier held
+	long misses;			// no of loads of a page the tier did not hold
+	long spills;			// no of pages spilled to make room
+	long bytes_in;			// total size of the pages stored
+	long bytes_out;			// total size of the pages stored, compressed
+	long memory;			// memory taken by the slabs now
+	int pages;			// no of pages held now
+};
+
+
+
+/*
+Create an empty tier for the pages 0 .. npages-1 of "page_size" bytes, using at most "budget" bytes of slabs.
+"spill" is called with every page spilled to make room, its contents and 1 if it is dirty.
+Returns a pointer to the new tier, or null on failure.
+*/
+struct ztier * ztier_create( long budget, int npages, int page_size, void (*spill)( int page, const char *data, int dirty ) );
+
+
+
+/* Delete a tier and free its memory, the pages it holds are lost. */
+void ztier_delete( struct ztier *z );
+
+
+
+/*
+Compress and store "page" from "data", spilling older pages if there is not enough room.
+"dirty" is 1 if the page has changed since it was last written to disk.
+Returns 1 if the page was stored, 0 if it was not and must be written to disk as usual.
+*/
+int ztier_store( struct ztier *z, int page, const char *data, int dirty );
+
+
+
+/*
+Load "page" into "data" and remove it from the tier, storing in "dirty" whether it has to be written to disk some day.
+Returns 1 if the tier held the page, 0 if it did not.
+*/
+int ztier_load( struct ztier *z, int page, char *data, int *dirty );
+
+
+
+/* Fill "stats" with the statistics of a tier. */
+void ztier_get_stats( struct ztier *z, struct ztier_stats *stats );
+
+
+
+#endif